@@ -24,6 +24,12 @@ struct TestPass : public ModulePass {
         errs() << "\n";
         errs() << "Worklist iterations: " << analysis.worklistIterations << "\n";
         errs() << "Times ran on function: " << analysis.timesRanOnFunction << "\n";
+        if (analysis.isIncomplete()) {
+            // The facts that were computed before the analysis was stopped
+            // aren't results, so don't print them.
+            errs() << "The analysis is incomplete, so no facts are printed\n";
+            return false;
+        }
 
         for (Function &F : M) {
             if (F.isDeclaration())
@@ -40,7 +46,7 @@ struct TestPass : public ModulePass {
                 for (BasicBlock &BB : F) {
                     errs() << BB.getName() << ":\n";
                     for (Instruction &I : BB) {
-                        auto sv = pt->find(&I)->second;
+                        auto sv = analysis.getFactsAt(pt, &I);
                         auto l = sv.first;
                         auto p = sv.second;
                         errs() << "Lin: \033[1;31m";
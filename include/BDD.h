@@ -0,0 +1,85 @@
+#ifndef LFCPA_BDD_H
+#define LFCPA_BDD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+
+// The number of bits used to encode a node ID. Sets of nodes are BDDs over
+// variables 0..BDD_DOMAIN_BITS-1 and relations use the next BDD_DOMAIN_BITS
+// variables for the second component of each pair. Putting all of the first
+// component's variables first means that a relation is a tree of pointer IDs
+// whose leaves are shared BDDs of pointee sets.
+#define BDD_DOMAIN_BITS 24
+
+class BDDManager;
+
+// A reference-counted handle to a node in the BDDManager's node table. Nodes
+// that are not reachable from a handle are reclaimed when the table is
+// garbage collected.
+class BDD {
+    public:
+        BDD() : root(0) {}
+        BDD(const BDD &Other);
+        BDD &operator=(const BDD &Other);
+        ~BDD();
+
+        static BDD element(unsigned Id);
+        static BDD pair(unsigned First, unsigned Second);
+
+        inline bool isFalse() const { return root == 0; }
+        inline unsigned getIndex() const { return root; }
+        inline bool operator==(const BDD &Other) const { return root == Other.root; }
+        inline bool operator!=(const BDD &Other) const { return root != Other.root; }
+
+        BDD operator|(const BDD &Other) const;
+        BDD operator&(const BDD &Other) const;
+        // The elements of this BDD that are not in Other.
+        BDD operator-(const BDD &Other) const;
+
+        // For a relation, the set of second components paired with First,
+        // as a BDD over the second component's variables.
+        BDD cofactor(unsigned First) const;
+        // For a set, whether it contains Id.
+        bool contains(unsigned Id) const;
+        // For a relation, the set of first components.
+        BDD domain() const;
+        // For a relation, the set of second components, as a set.
+        BDD range() const;
+        // The number of assignments to the variables in [Lo, Hi) that satisfy
+        // the BDD; the BDD may only depend on those variables.
+        uint64_t count(unsigned Lo, unsigned Hi) const;
+    private:
+        explicit BDD(unsigned Root);
+        unsigned root;
+        friend class BDDManager;
+        friend class BDDIterator;
+};
+
+// Enumerates the satisfying assignments of a BDD over the variables [Lo, Hi)
+// in increasing order, treating variable Lo as the most significant bit.
+class BDDIterator {
+    public:
+        BDDIterator() : lo(0), depth(0), done(true) {}
+        BDDIterator(const BDD &B, unsigned Lo, unsigned Hi);
+        // Positions the iterator at Value, which must satisfy B.
+        BDDIterator(const BDD &B, unsigned Lo, unsigned Hi, uint64_t Value);
+
+        inline bool atEnd() const { return done; }
+        inline uint64_t value() const { return bits; }
+        void next();
+
+        inline bool operator==(const BDDIterator &Y) const {
+            return done ? Y.done : !Y.done && bits == Y.bits;
+        }
+    private:
+        unsigned lo, depth;
+        bool done;
+        uint64_t bits;
+        // nodes[k] is the node reached after assigning the first k variables.
+        llvm::SmallVector<unsigned, 2 * BDD_DOMAIN_BITS + 1> nodes;
+        bool search(unsigned K, unsigned FirstBit);
+};
+
+#endif
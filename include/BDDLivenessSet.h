@@ -0,0 +1,124 @@
+#ifndef LFCPA_BDDLIVENESSSET_H
+#define LFCPA_BDDLIVENESSSET_H
+
+#include <iterator>
+
+#include "BDD.h"
+#include "PointsToNode.h"
+
+// A set of nodes, stored as a BDD over the bits of the node IDs. This is the
+// representation used when the analysis is built with LFCPA_USE_BDDS. The
+// nodes are iterated over in order of increasing ID.
+class LivenessSet {
+    public:
+        typedef unsigned size_type;
+
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef PointsToNode* value_type;
+            typedef signed difference_type;
+            typedef PointsToNode* const* pointer;
+            typedef PointsToNode* reference;
+
+            const_iterator() {}
+            const_iterator(const BDDIterator &I) : I(I) {}
+
+            inline reference operator*() const {
+                return PointsToNode::getById(I.value());
+            }
+
+            inline bool operator==(const const_iterator &Y) const {
+                return I == Y.I;
+            }
+            inline bool operator!=(const const_iterator &Y) const {
+                return !operator==(Y);
+            }
+
+            const_iterator &operator++() {
+                I.next();
+                return *this;
+            }
+        private:
+            BDDIterator I;
+        };
+        typedef const_iterator iterator;
+
+        inline const_iterator begin() const {
+            return const_iterator(BDDIterator(s, 0, BDD_DOMAIN_BITS));
+        }
+
+        inline const_iterator find(PointsToNode *N) const {
+            if (!s.contains(N->getId()))
+                return end();
+            return const_iterator(BDDIterator(s, 0, BDD_DOMAIN_BITS, N->getId()));
+        }
+
+        inline const_iterator end() const {
+            return const_iterator();
+        }
+
+        inline bool empty() const {
+            return s.isFalse();
+        }
+
+        inline int size() const {
+            return s.count(0, BDD_DOMAIN_BITS);
+        }
+
+        inline void clear() {
+            s = BDD();
+        }
+
+        inline size_type erase(PointsToNode *N) {
+            // When we kill a node, it's children (i.e. GEPs) are also killed.
+            for (PointsToNode *Child : N->children) {
+                assert(isa<GEPPointsToNode>(Child) && "All children of PointsToNodes should be GEPs");
+                s = s - BDD::element(Child->getId());
+            }
+
+            if (!s.contains(N->getId()))
+                return 0;
+            s = s - BDD::element(N->getId());
+            return 1;
+        }
+
+        inline bool insert(PointsToNode *N) {
+            if (N->singlePointee() || (!N->hasPointerType() && !N->isAlwaysSummaryNode()) || isa<UnknownPointsToNode>(N))
+                return false;
+
+            BDD Old = s;
+            s = s | BDD::element(N->getId());
+            return s != Old;
+        }
+
+        inline void insertAll(const LivenessSet &L) {
+            s = s | L.s;
+        }
+
+        inline bool operator==(const LivenessSet &R) const {
+            return s == R.s;
+        }
+
+        inline bool operator!=(const LivenessSet &R) const {
+            return !operator==(R);
+        }
+
+        void dump() const;
+
+        inline unsigned hash() const {
+            return s.getIndex();
+        }
+
+        bool isSubset(const LivenessSet &S) const;
+
+        void eraseNonSummaryNodes(const CallString &CS);
+
+        inline const BDD &getBDD() const {
+            return s;
+        }
+    private:
+        BDD s;
+};
+
+#endif
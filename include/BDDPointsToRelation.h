@@ -0,0 +1,281 @@
+#ifndef LFCPA_BDDPOINTSTORELATION_H
+#define LFCPA_BDDPOINTSTORELATION_H
+
+#include "BDD.h"
+#include "LivenessSet.h"
+#include "PointsToNode.h"
+
+// The relation is stored as a BDD over the bits of the pointer's ID followed
+// by the bits of the pointee's ID. This is the representation used when the
+// analysis is built with LFCPA_USE_BDDS. Pointers with the same pointees share
+// the BDD of their pointees, so products of large sets, such as the pairs
+// added for calls to declarations, take space proportional to the sizes of
+// the sets rather than to the number of pairs. Pairs are iterated over in the
+// order given by PointsToPairLess.
+class PointsToRelation {
+public:
+    typedef PointsToNodeSet NodeSet;
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<PointsToNode *, PointsToNode *> value_type;
+        typedef signed difference_type;
+        typedef std::pair<PointsToNode *, PointsToNode *> const* pointer;
+        typedef std::pair<PointsToNode *, PointsToNode *> const& reference;
+
+        const_iterator() {}
+        const_iterator(const BDD &S) : I(S, 0, 2 * BDD_DOMAIN_BITS) {
+            load();
+        }
+
+        inline reference operator*() const { return Current; }
+        inline pointer operator->() const { return &operator*(); }
+
+        inline bool operator==(const const_iterator &Y) const {
+            return I == Y.I;
+        }
+        inline bool operator !=(const const_iterator &Y) const {
+            return !operator==(Y);
+        }
+
+        const_iterator &operator++() {
+            I.next();
+            load();
+            return *this;
+        }
+    private:
+        BDDIterator I;
+        std::pair<PointsToNode *, PointsToNode *> Current;
+
+        inline void load() {
+            if (!I.atEnd()) {
+                uint64_t V = I.value();
+                Current.first = PointsToNode::getById(V >> BDD_DOMAIN_BITS);
+                Current.second = PointsToNode::getById(V & ((1u << BDD_DOMAIN_BITS) - 1));
+            }
+        }
+    };
+
+    class const_pointee_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef PointsToNode* value_type;
+        typedef signed difference_type;
+        typedef PointsToNode* const* pointer;
+        typedef PointsToNode* const& reference;
+
+        const_pointee_iterator(const BDDIterator &I) : single_value(false), I(I), Value(nullptr) {
+            load();
+        }
+
+        const_pointee_iterator(PointsToNode *Value) : single_value(true), Value(Value) {}
+
+        inline reference operator*() const { return Value; }
+        inline pointer operator->() const { return &operator*(); }
+
+        inline bool operator==(const const_pointee_iterator &Y) const {
+            assert (single_value == Y.single_value);
+            if (single_value)
+                return Value == Y.Value;
+            else
+                return I == Y.I;
+        }
+        inline bool operator !=(const const_pointee_iterator &Y) const {
+            return !operator==(Y);
+        }
+
+        const_pointee_iterator &operator++() {
+            if (single_value) {
+                assert(Value);
+                Value = nullptr;
+            }
+            else {
+                I.next();
+                load();
+            }
+            return *this;
+        }
+
+        inline bool atEnd() const { return single_value ? Value == nullptr : I.atEnd(); }
+    private:
+        // Nodes that always have a single pointee are not in the relation,
+        // so the iterator either walks over the pointees in the BDD or
+        // returns the single pointee.
+        bool single_value;
+        BDDIterator I;
+        PointsToNode *Value;
+
+        inline void load() {
+            Value = I.atEnd() ? nullptr : PointsToNode::getById(I.value());
+        }
+    };
+
+    template <typename DomainIterator>
+    class const_restriction_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<PointsToNode *, PointsToNode *> value_type;
+        typedef signed difference_type;
+        typedef std::pair<PointsToNode *, PointsToNode *> const* pointer;
+        typedef std::pair<PointsToNode *, PointsToNode *> const& reference;
+
+        const_restriction_iterator(const BDD *S, DomainIterator DI, DomainIterator DE) : S(S), DI(DI), DE(DE), loaded(false), useSinglePointee(false) {
+            advance_iterators();
+        }
+
+        inline reference operator*() const { return current; }
+        inline pointer operator->() const { return &operator*(); }
+
+        inline bool operator==(const const_restriction_iterator &Y) const {
+            if (DI != Y.DI)
+                return false;
+            return DI == DE || (useSinglePointee == Y.useSinglePointee && I == Y.I);
+        }
+        inline bool operator !=(const const_restriction_iterator &Y) const {
+            return !operator==(Y);
+        }
+
+        const_restriction_iterator &operator++() {
+            if (useSinglePointee) {
+                ++DI;
+                loaded = false;
+            }
+            else
+                I.next();
+            advance_iterators();
+            return *this;
+        }
+
+        inline bool atEnd() const { return DI == DE; }
+    private:
+        inline void advance_iterators() {
+            // Advance DI until it reaches a node that has a pointee, and set
+            // I to iterate over the pointees of that node.
+            for (; DI != DE; ++DI, loaded = false) {
+                PointsToNode *N = *DI;
+                if (!loaded) {
+                    loaded = true;
+                    useSinglePointee = N->singlePointee();
+                    if (useSinglePointee) {
+                        current = std::make_pair(N, N->getSinglePointee());
+                        return;
+                    }
+                    I = BDDIterator(S->cofactor(N->getId()), BDD_DOMAIN_BITS, 2 * BDD_DOMAIN_BITS);
+                }
+                if (!I.atEnd()) {
+                    current = std::make_pair(N, PointsToNode::getById(I.value()));
+                    return;
+                }
+            }
+        }
+
+        const BDD *S;
+        DomainIterator DI, DE;
+        BDDIterator I;
+        bool loaded, useSinglePointee;
+        std::pair<PointsToNode *, PointsToNode *> current;
+    };
+
+    inline void insertAll(const PointsToRelation &R) {
+        s = s | R.s;
+    }
+
+    inline void clear() {
+        s = BDD();
+    }
+
+    inline bool insert(const std::pair<PointsToNode *, PointsToNode *> &N) {
+        if (N.first->singlePointee()) {
+            assert((N.first->getSinglePointee() == N.second || isa<UnknownPointsToNode>(N.second)) && "The pair given is incorrect.");
+            return false;
+        }
+
+        // If a value is a summary node, it may be, for example, an array of
+        // pointers, and therefore may have pointees.
+        if (isa<UnknownPointsToNode>(N.first) || (!N.first->hasPointerType() && !N.first->isAlwaysSummaryNode()))
+            return false;
+
+        BDD Old = s;
+        s = s | BDD::pair(N.first->getId(), N.second->getId());
+        return s != Old;
+    }
+
+    inline void unionRelationRestriction(const PointsToRelation &R, const LivenessSet &S) {
+        s = s | (R.s & S.getBDD());
+    }
+
+    inline bool operator==(const PointsToRelation &R) const {
+        return s == R.s;
+    }
+
+    inline bool operator!=(const PointsToRelation &R) const {
+        return !operator==(R);
+    }
+
+    inline const_pointee_iterator pointee_begin(const PointsToNode *N) const {
+        if (N->singlePointee())
+            return const_pointee_iterator(N->getSinglePointee());
+        return const_pointee_iterator(BDDIterator(s.cofactor(N->getId()), BDD_DOMAIN_BITS, 2 * BDD_DOMAIN_BITS));
+    }
+
+    inline const_pointee_iterator pointee_end(const PointsToNode *N) const {
+        if (N->singlePointee())
+            return const_pointee_iterator(nullptr);
+        return const_pointee_iterator(BDDIterator());
+    }
+
+    inline const_restriction_iterator<NodeSet::const_iterator> restriction_begin(const NodeSet &S) const {
+        return const_restriction_iterator<NodeSet::const_iterator>(&s, S.begin(), S.end());
+    }
+
+    inline const_restriction_iterator<NodeSet::const_iterator> restriction_end(const NodeSet &S) const {
+        return const_restriction_iterator<NodeSet::const_iterator>(&s, S.end(), S.end());
+    }
+
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_begin(const LivenessSet &S) const {
+        return const_restriction_iterator<LivenessSet::const_iterator>(&s, S.begin(), S.end());
+    }
+
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_end(const LivenessSet &S) const {
+        return const_restriction_iterator<LivenessSet::const_iterator>(&s, S.end(), S.end());
+    }
+
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_begin(const LivenessSet *S) const {
+        return restriction_begin(*S);
+    }
+
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_end(const LivenessSet *S) const {
+        return restriction_end(*S);
+    }
+
+    inline const_iterator begin() const {
+        return const_iterator(s);
+    }
+
+    inline const_iterator end() const {
+        return const_iterator();
+    }
+
+    inline bool empty() const {
+        return s.isFalse();
+    }
+
+    inline unsigned size() const {
+        return s.count(0, 2 * BDD_DOMAIN_BITS);
+    }
+
+    bool isSubset(const PointsToRelation &R) const;
+
+    inline unsigned hash() const {
+        return s.getIndex();
+    }
+
+    void insertEverythingInto(LivenessSet &S) const;
+
+    void dump() const;
+private:
+    BDD s;
+};
+
+#endif
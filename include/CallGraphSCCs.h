@@ -0,0 +1,48 @@
+#ifndef LFCPA_CALLGRAPHSCCS_H
+#define LFCPA_CALLGRAPHSCCS_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "UnificationPointsTo.h"
+
+using namespace llvm;
+
+// The call graph of the functions that are analysed, condensed into strongly
+// connected components. The edges are the direct calls to definitions in the
+// module and the indirect calls that the unification pre-pass resolved, plus
+// the targets of indirect calls as the analysis resolves them.
+// The components are recomputed when they are next needed after an edge is
+// added.
+class CallGraphSCCs {
+    public:
+        CallGraphSCCs() : changed(false) {}
+
+        void addDirectCalls(const Module &M, const UnificationPointsTo &Unification);
+        void addCall(const Function *Caller, const Function *Callee);
+
+        // Returns true if F can call itself, directly or through other
+        // functions, using the edges known so far.
+        bool isRecursive(const Function *F);
+        // Returns true if Caller can call Callee, directly or through other
+        // functions, using the edges known so far.
+        bool mayCall(const Function *Caller, const Function *Callee);
+    private:
+        DenseMap<const Function *, SmallVector<const Function *, 4>> callees;
+        // The component that each function is in, and whether each component
+        // contains a cycle.
+        DenseMap<const Function *, unsigned> components;
+        SmallVector<bool, 32> cyclic;
+        // The functions that each function can reach, for the functions that
+        // have been asked about since the last edge was added.
+        DenseMap<const Function *, SmallPtrSet<const Function *, 16>> reachable;
+        bool changed;
+
+        void computeComponents();
+        unsigned visit(const Function *F, DenseMap<const Function *, unsigned> &Numbers, SmallVectorImpl<const Function *> &Stack, unsigned &Next);
+};
+
+#endif
@@ -1,20 +1,67 @@
 #ifndef LFCPA_CALLSTRING_H
 #define LFCPA_CALLSTRING_H
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/Allocator.h"
 
 using namespace llvm;
 
+class CallGraphSCCs;
+class CallStringTable;
+
+// A node in the trie of call strings owned by a CallStringTable. Each node is
+// the call string made up of the calls on the path from the root to it, and
+// caches the facts about that string which are queried while the analysis
+// runs.
+class CallStringNode {
+    public:
+        CallStringNode(CallStringTable *Table, const CallStringNode *Parent, const Instruction *Call);
+
+        inline const CallStringNode *getParent() const { return parent; }
+        inline const Instruction *getCall() const { return call; }
+        inline unsigned getDepth() const { return depth; }
+        inline bool isTruncated() const { return truncated; }
+
+        // The number of calls in the string that are in F, up to 2.
+        inline unsigned callsIn(const Function *F) const {
+            auto I = calls.find(F);
+            return I == calls.end() ? 0 : I->second;
+        }
+    private:
+        CallStringTable *table;
+        const CallStringNode *parent;
+        const Instruction *call;
+        unsigned depth;
+        // Whether calls before the first one in the string were dropped to
+        // keep it within the length limit.
+        bool truncated;
+        // Whether the node or one of its ancestors is a copy that isn't in
+        // the trie (see CallString::makeUnique).
+        bool unique;
+        DenseMap<const Function *, unsigned> calls;
+        mutable DenseMap<const Instruction *, const CallStringNode *> children;
+        // The strings made by adding a call once the limit is reached.
+        mutable DenseMap<const Instruction *, const CallStringNode *> shifted;
+        friend class CallString;
+        friend class CallStringTable;
+};
+
+// A call string is a non-cyclic part followed by any number of repetitions of
+// an optional cyclic part. Both parts are interned in a trie, so call strings
+// can be copied, extended and compared in constant time.
 class CallString {
     public:
-        static CallString empty();
         CallString addCallSite(const Instruction *) const;
+        CallString addMergedCallSite(const Instruction *) const;
         bool isNonCyclicPrefix(const CallString &) const;
         CallString createCyclicFromPrefix(const CallString &) const;
         bool matches(const CallString &) const;
-        CallString(const CallString &other) : nonCyclic(other.nonCyclic), cyclic(other.cyclic) {}
+        bool reachesSameFunctions(const CallString &, function_ref<bool(const Function *)>) const;
+        CallString makeUnique() const;
         void dump() const;
 
         inline bool operator==(const CallString &C) const {
@@ -22,23 +69,22 @@ class CallString {
         }
 
         inline bool isEmpty() const {
-            return cyclic.empty() && nonCyclic.empty();
+            return cyclic->depth == 0 && nonCyclic->depth == 0;
         }
 
         inline bool isCyclic() const {
-            return !cyclic.empty();
+            return cyclic->depth != 0;
         }
 
         inline int size() const {
-            return nonCyclic.size();
+            return nonCyclic->depth;
         }
 
         inline const Instruction *getLastCall() const {
-            if (nonCyclic.empty())
-                return nullptr;
-            return nonCyclic.back();
+            return nonCyclic->call;
         }
 
+        const Instruction *getFirstCall() const;
 
         inline const Function *getLastCalledFunction() const {
             if (getLastCall() == nullptr)
@@ -49,45 +95,60 @@ class CallString {
             return nullptr;
         }
 
-        inline bool containsCallIn(const Function *F) const {
-            for (const Instruction *I : nonCyclic)
-                if (const CallInst *CI = dyn_cast<CallInst>(I))
-                    if (CI->getParent()->getParent() == F)
-                        return true;
-            for (const Instruction *I : cyclic)
-                if (const CallInst *CI = dyn_cast<CallInst>(I))
-                    if (CI->getParent()->getParent() == F)
-                        return true;
-            return false;
+        inline const CallStringNode *getNonCyclicPart() const {
+            return nonCyclic;
         }
 
-        inline bool reachedMoreThanOnce(const Function *F) const {
-            bool foundCall = false;
-            const CallInst *Last = nullptr;
-            for (const Instruction *I : nonCyclic) {
-                if (const CallInst *CI = dyn_cast<CallInst>(I)) {
-                    if (CI->getParent()->getParent() == F) {
-                        if (foundCall)
-                            return true;
-                        else
-                            foundCall = true;
-                    }
-                    Last = CI;
-                }
-            }
-
-            if (foundCall && Last != nullptr) {
-                // This is imprecise because Last may not actually be a call to
-                // F if getCalledFunction is nullptr, but it is safe.
-                return Last->getCalledFunction() == nullptr || Last->getCalledFunction() == F;
-            }
-
-            return false;
+        inline const CallStringNode *getCyclicPart() const {
+            return cyclic;
         }
+
+        inline bool isTruncated() const {
+            return nonCyclic->truncated;
+        }
+
+        // Whether the string is a single call whose callers are unknown (see
+        // addMergedCallSite).
+        inline bool isMerged() const {
+            return nonCyclic->truncated && nonCyclic->depth == 1;
+        }
+
+        // The calls that were dropped from a truncated string are unknown.
+        // The string leads to F, or to a caller of F, so F can only be among
+        // them if it may call itself.
+        bool containsCallIn(const Function *F) const;
+
+        bool reachedMoreThanOnce(const Function *F) const;
+    private:
+        const CallStringNode *nonCyclic, *cyclic;
+        CallString(const CallStringNode *NonCyclic, const CallStringNode *Cyclic) : nonCyclic(NonCyclic), cyclic(Cyclic) {}
+        friend class CallStringTable;
+};
+
+// Owns the trie of call strings used by an analysis. The strings that have
+// been truncated by -lfcpa-k are kept under a separate root, so that they
+// aren't confused with the strings that are made up of the same calls but
+// start at the analysed function. The call graph tells which functions may
+// be among the calls that were dropped from them.
+class CallStringTable {
+    public:
+        CallStringTable(CallGraphSCCs &CallGraph) : root(this, nullptr, nullptr), truncatedRoot(this, nullptr, nullptr), callGraph(CallGraph) {
+            truncatedRoot.truncated = true;
+        }
+
+        inline CallString empty() const {
+            return CallString(&root, &root);
+        }
+
+        const CallStringNode *getChild(const CallStringNode *N, const Instruction *Call);
+        const CallStringNode *getCopy(const CallStringNode *N);
+        const CallStringNode *getShifted(const CallStringNode *N, const Instruction *Call, unsigned Limit);
+        const CallStringNode *getTruncated(const Instruction *Call);
+        bool isRecursive(const Function *F) const;
     private:
-        SmallVector<const Instruction *, 8> nonCyclic;
-        SmallVector<const Instruction *, 8> cyclic;
-        CallString () {}
+        CallStringNode root, truncatedRoot;
+        SpecificBumpPtrAllocator<CallStringNode> allocator;
+        CallGraphSCCs &callGraph;
 };
 
 #endif
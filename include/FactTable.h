@@ -0,0 +1,81 @@
+#ifndef LFCPA_FACTTABLE_H
+#define LFCPA_FACTTABLE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+
+#include "LivenessSet.h"
+#include "PointsToRelation.h"
+
+// Hash-conses immutable sets: each distinct set is stored exactly once, so two
+// interned sets are equal if and only if they are the same object.
+template <typename SetTy>
+class FactInterner {
+    public:
+        FactInterner() : bytes(0) {}
+
+        const SetTy *intern(const SetTy &S) {
+            // DenseMap reserves the two largest keys, so don't use the top
+            // bit of the hash.
+            unsigned H = S.hash() & 0x7fffffff;
+            SmallVector<const SetTy *, 1> &Bucket = table[H];
+            for (const SetTy *E : Bucket)
+                if (*E == S)
+                    return E;
+
+            const SetTy *Result = new (allocator.Allocate()) SetTy(S);
+            Bucket.push_back(Result);
+            bytes += sizeof(SetTy) + S.size() * sizeof(void *);
+            return Result;
+        }
+
+        // An estimate of the memory used by the interned sets, which counts a
+        // pointer for each element.
+        inline size_t getBytes() const {
+            return bytes;
+        }
+    private:
+        DenseMap<unsigned, SmallVector<const SetTy *, 1>> table;
+        SpecificBumpPtrAllocator<SetTy> allocator;
+        size_t bytes;
+};
+
+// The interned liveness sets and points-to relations used by an analysis.
+// Interned sets are never freed before the table itself is destroyed, but
+// sets are shared between instructions and call strings, so far fewer are
+// created than there are program points.
+class FactTable {
+    public:
+        FactTable() {
+            emptyL = intern(LivenessSet());
+            emptyR = intern(PointsToRelation());
+        }
+
+        inline const LivenessSet *intern(const LivenessSet &L) {
+            return liveness.intern(L);
+        }
+
+        inline const PointsToRelation *intern(const PointsToRelation &R) {
+            return relations.intern(R);
+        }
+
+        inline const LivenessSet *emptyLiveness() const {
+            return emptyL;
+        }
+
+        inline const PointsToRelation *emptyRelation() const {
+            return emptyR;
+        }
+
+        inline size_t getBytes() const {
+            return liveness.getBytes() + relations.getBytes();
+        }
+    private:
+        FactInterner<LivenessSet> liveness;
+        FactInterner<PointsToRelation> relations;
+        const LivenessSet *emptyL;
+        const PointsToRelation *emptyR;
+};
+
+#endif
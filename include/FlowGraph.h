@@ -0,0 +1,94 @@
+#ifndef LFCPA_FLOWGRAPH_H
+#define LFCPA_FLOWGRAPH_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
+using namespace llvm;
+
+// The graph that facts are propagated along when a function is analysed. In
+// the dense graph every instruction is a node and the edges are those of the
+// control flow graph. In the sparse graph only the first instruction, returns
+// and pointer-relevant instructions are nodes, and there is an edge between
+// two nodes if there is a path between them through instructions that aren't
+// nodes. The transfer functions of those instructions just pass the facts
+// through, so propagating along the sparse graph gives the same facts at the
+// nodes. Nodes are numbered in program order, and also have a position in a
+// reverse post-order of the graph that the solver uses to schedule them.
+class FlowGraph {
+    public:
+        FlowGraph(const Function *F, bool Sparse);
+
+        inline unsigned size() const { return instructions.size(); }
+        inline const Instruction *getInstruction(unsigned N) const { return instructions[N]; }
+        inline bool hasNode(const Instruction *I) const { return numbers.count(I) != 0; }
+
+        inline unsigned getNode(const Instruction *I) const {
+            auto Found = numbers.find(I);
+            assert(Found != numbers.end() && "The instruction is not a node.");
+            return Found->second;
+        }
+
+        inline ArrayRef<unsigned> succs(unsigned N) const { return successors[N]; }
+        inline ArrayRef<unsigned> preds(unsigned N) const { return predecessors[N]; }
+
+        // The position of N in the reverse post-order, and the node at a
+        // position. Nodes that can't be reached from the first instruction
+        // come last, in program order.
+        inline unsigned getRPONumber(unsigned N) const { return rpoNumbers[N]; }
+        inline unsigned getNodeAtRPO(unsigned Position) const { return rpo[Position]; }
+
+        // Finds the nodes that reach I and the nodes that I reaches without
+        // passing through any other node, where I is not a node.
+        void getSurroundingNodes(const Instruction *I, SmallVectorImpl<unsigned> &Before, SmallVectorImpl<unsigned> &After) const;
+    private:
+        void computeRPO();
+
+        SmallVector<const Instruction *, 128> instructions;
+        DenseMap<const Instruction *, unsigned> numbers;
+        SmallVector<SmallVector<unsigned, 2>, 128> successors, predecessors;
+        SmallVector<unsigned, 128> rpo, rpoNumbers;
+        // The nodes reached from the start of each block and those that reach
+        // the end of it without passing through another node.
+        DenseMap<const BasicBlock *, SmallVector<unsigned, 2>> entries, exits;
+};
+
+// The nodes of a flow graph that the solver still has to look at. Nodes whose
+// predecessors' points-to information changed are taken in reverse post-order
+// and nodes whose successors' liveness changed in post-order, so that each
+// kind of fact is propagated in the direction it flows. Since the first node
+// left in the order is always taken, a loop is stabilised before the nodes
+// after it are looked at, and inner loops before outer ones.
+class FlowGraphWorklist {
+    public:
+        // The worklist starts with every node in it, or with none if Empty is
+        // set.
+        FlowGraphWorklist(const FlowGraph &G, bool Empty = false) : graph(G), forward(G.size(), !Empty), backward(G.size(), !Empty) {}
+
+        inline bool empty() const { return forward.none() && backward.none(); }
+        inline void addForward(unsigned N) { forward.set(graph.getRPONumber(N)); }
+        inline void addBackward(unsigned N) { backward.set(graph.size() - 1 - graph.getRPONumber(N)); }
+
+        // Removes and returns the next node. Liveness is propagated first,
+        // since it determines which pairs the points-to information keeps.
+        inline unsigned pop() {
+            unsigned Position = graph.size() - 1 - backward.find_first();
+            if (backward.none())
+                Position = forward.find_first();
+            forward.reset(Position);
+            backward.reset(graph.size() - 1 - Position);
+            return graph.getNodeAtRPO(Position);
+        }
+    private:
+        const FlowGraph &graph;
+        // Indexed by the position of the node in the reverse post-order and
+        // the post-order respectively.
+        BitVector forward, backward;
+};
+
+#endif
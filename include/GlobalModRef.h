@@ -0,0 +1,36 @@
+#ifndef LFCPA_GLOBALMODREF_H
+#define LFCPA_GLOBALMODREF_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+
+#include "UnificationPointsTo.h"
+
+using namespace llvm;
+
+// The global variables that each function may read or write, either itself or
+// through the functions that it calls. Only the globals whose addresses are
+// never taken (that are only loaded from and stored to) are tracked; the
+// others may be reached through any pointer, so every function is assumed to
+// access them, as are the functions that make indirect calls that the
+// unification pre-pass didn't resolve.
+class GlobalModRef {
+    public:
+        void compute(const Module &M, const UnificationPointsTo &Unification);
+
+        // Returns true if F, or a function that it may call, may read or
+        // write G.
+        bool mayAccess(const Function *F, const GlobalVariable *G) const;
+    private:
+        SmallPtrSet<const GlobalVariable *, 32> tracked;
+        DenseMap<const Function *, SmallPtrSet<const GlobalVariable *, 8>> accessed;
+        SmallPtrSet<const Function *, 8> accessesAll;
+
+        bool isOnlyLoadedAndStored(const Value *V);
+        void addUsedGlobals(const Value *V, SmallPtrSetImpl<const GlobalVariable *> &Used, SmallPtrSetImpl<const Constant *> &Visited);
+};
+
+#endif
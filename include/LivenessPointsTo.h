@@ -1,50 +1,159 @@
 #ifndef LFCPA_LIVENESSPOINTSTO_H
 #define LFCPA_LIVENESSPOINTSTO_H
 
+#include <chrono>
+#include <memory>
 #include <set>
+#include <vector>
 
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Twine.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
 
+#include "CallGraphSCCs.h"
+#include "GlobalModRef.h"
 #include "PointsToData.h"
 #include "PointsToNode.h"
 #include "PointsToNodeFactory.h"
+#include "UnificationPointsTo.h"
 
 using namespace llvm;
 
+// The boundary information that a function was last analysed with when it was
+// called with a particular call string. The sets are interned.
+struct CallBoundary {
+    const PointsToRelation *entryPointsTo;
+    const LivenessSet *exitLiveness;
+    bool returnValuesLive;
+};
+
+// The state of the solver for a context when its last run ended, so that the
+// next run can carry on from the fixed point that it reached.
+struct SolverState {
+    // Lout and ain at each node of the flow graph.
+    IntraproceduralPointsTo nonresult;
+    // The ain and lout that each node's aout and lin were last computed from.
+    std::vector<const PointsToRelation *> lastAin;
+    std::vector<const LivenessSet *> lastLout;
+    // The number of node IDs when the run started, and the number of nodes
+    // that had been turned into summary nodes when the facts were last
+    // brought up to date with them.
+    unsigned numIds, summaryNodes;
+};
+
+// Pairs of a placeholder and the object of the caller that it stands for.
+typedef SmallVector<std::pair<PointsToNode *, PointsToNode *>, 4> Substitution;
+
+// A value context that a call was bound to, with the objects that the
+// placeholders in its facts stand for at the call.
+struct CallBinding {
+    IntraproceduralPointsTo *facts;
+    Substitution substitution;
+};
+
+// A context of the call string analysis that converged under an earlier
+// root. The calls from later roots that reach its function with the same
+// boundary information can use its map rather than analysing it again.
+struct ConvergedContext {
+    CallString callString;
+    IntraproceduralPointsTo *facts;
+    bool returnValuesLive;
+    // The number of summary nodes when the root converged; the facts may not
+    // hold once there are more.
+    unsigned summaryNodes;
+};
+
 class LivenessPointsTo {
 public:
-    SmallVector<std::tuple<CallString, const Function *, PointsToRelation, LivenessSet, bool>, 64> callData;
+    LivenessPointsTo() : incomplete(false), startIterations(0), callStrings(callGraph), data(facts) {}
+    DenseMap<std::pair<const Function *, const CallStringNode *>, CallBoundary> callData;
+    // Every value context that each call has been bound to. The results of
+    // all of them are used at the call, so that the facts there only grow.
+    DenseMap<std::pair<const Function *, const CallStringNode *>, SmallVector<CallBinding, 1>> callBindings;
     void runOnModule(Module &);
     ProcedurePointsTo *getPointsTo(Function &) const;
-    std::set<PointsToNode *> getPointsToSet(const Value *, bool &);
+    std::pair<const LivenessSet *, const PointsToRelation *> getFactsAt(const IntraproceduralPointsTo *, const Instruction *);
+    PointsToNodeSet getPointsToSet(const Value *, bool &);
+    bool mayAliasByUnification(const Value *, const Value *) const;
+    // Whether the analysis was stopped by a budget, so that its facts are
+    // missing pairs.
+    bool isIncomplete() const { return incomplete; }
+    // Statistics for every analysis run in the process. The budgets only
+    // count the iterations since the current analysis started.
     static unsigned worklistIterations, timesRanOnFunction;
 private:
-    void insertNewPairs(PointsToRelation &, const Instruction *, PointsToRelation &, LivenessSet &);
-    void subtractKill(const CallString &CS, LivenessSet &, const Instruction *, PointsToRelation &);
-    void unionRef(LivenessSet &, const Instruction *, LivenessSet &, PointsToRelation &);
-    void computeLout(const Instruction *, LivenessSet &, IntraproceduralPointsTo &);
+    void insertNewPairs(PointsToRelation &, const Instruction *, const PointsToRelation &, const LivenessSet &);
+    void subtractKill(const CallString &CS, LivenessSet &, const Instruction *, const PointsToRelation &);
+    void unionRef(LivenessSet &, const Instruction *, const LivenessSet &, const PointsToRelation &);
+    void computeLout(const FlowGraph &, unsigned, const LivenessSet *&, IntraproceduralPointsTo &);
     bool isArgument(const Function *, const PointsToNode *);
-    bool computeAin(const Instruction *, const Function *, PointsToRelation &, LivenessSet &, IntraproceduralPointsTo *, bool InsertAtFirstInstruction);
-    bool getCalledFunctions(SmallVector<const Function *, 8> &, const CallInst *, PointsToRelation &);
-    void addLinCalledDeclaration(LivenessSet &, const CallString &, const CallInst *, LivenessSet &);
-    void addLinAnalysableCalledFunction(LivenessSet &, const Function *, const CallString &, const CallInst *, LivenessSet &, LivenessSet &);
-    LivenessSet findRelevantNodes(const CallInst *, LivenessSet &);
-    bool computeLin(const CallString &, const Instruction *, PointsToRelation &, LivenessSet &, LivenessSet &);
-    void addAoutCalledDeclaration(PointsToRelation &, const CallInst *, PointsToRelation &, LivenessSet &);
-    void addAoutAnalysableCalledFunction(PointsToRelation &, const Function *, const CallString &, const CallInst *, PointsToRelation &, LivenessSet &);
-    bool computeAout(const CallString &, const Instruction *, PointsToRelation &, PointsToRelation &, LivenessSet &);
-    std::set<PointsToNode *> getKillableDeclaration(const CallInst *, PointsToRelation &);
+    bool computeAin(const FlowGraph &, unsigned, const Function *, const PointsToRelation *&, const LivenessSet &, IntraproceduralPointsTo *, bool InsertAtFirstInstruction);
+    bool getCalledFunctions(SmallVector<const Function *, 8> &, const CallInst *, const PointsToRelation &);
+    void addLinCalledDeclaration(LivenessSet &, const CallString &, const CallInst *, const LivenessSet &);
+    void addLinAnalysableCalledFunction(LivenessSet &, const Function *, const CallString &, const CallInst *, const PointsToRelation &, const LivenessSet &, LivenessSet &);
+    LivenessSet findRelevantNodes(const CallInst *, const LivenessSet &);
+    bool computeLin(const CallString &, const Instruction *, const PointsToRelation &, const LivenessSet *&, const LivenessSet &);
+    void addAoutCalledDeclaration(PointsToRelation &, const CallInst *, const PointsToRelation &, const LivenessSet &);
+    void addAoutAnalysableCalledFunction(PointsToRelation &, const Function *, const CallString &, const CallInst *, const PointsToRelation &, const LivenessSet &);
+    bool computeAout(const CallString &, const Instruction *, const PointsToRelation &, const PointsToRelation *&, const LivenessSet &);
+    bool propagateAout(const CallString &, const Instruction *, const PointsToRelation &, const PointsToRelation &, const PointsToRelation *&, const LivenessSet &, const LivenessSet &);
+    bool propagateLin(const CallString &, const Instruction *, const PointsToRelation &, const LivenessSet *&, const LivenessSet &, const LivenessSet &);
+    PointsToNodeSet getKillableDeclaration(const CallInst *, const PointsToRelation &);
     std::pair<LivenessSet, PointsToRelation> getCalledFunctionResult(const CallString &, const Function *);
-    std::set<PointsToNode *> getReturnValues(const Function *);
-    LivenessSet computeFunctionExitLiveness(const CallInst *, LivenessSet *);
-    PointsToRelation replaceActualArgumentsWithFormal(const Function *, const CallInst *, PointsToRelation *);
+    void addCalledContextResult(std::pair<LivenessSet, PointsToRelation> &, const Function *, IntraproceduralPointsTo *, const Substitution &);
+    bool canName(const Function *, const PointsToNode *);
+    void findObservableNodes(const Function *, ArrayRef<PointsToNode *>, const PointsToRelation &, const LivenessSet &, SmallPtrSetImpl<PointsToNode *> &, SmallVectorImpl<PointsToNode *> &);
+    void findObservableNodesAtCall(const Function *, const CallInst *, const PointsToRelation &, const LivenessSet &, SmallPtrSetImpl<PointsToNode *> &);
+    PointsToNode *substitute(PointsToNode *, const Substitution &, bool);
+    void makeParametric(const CallString &, const Function *, PointsToRelation &, LivenessSet &, Substitution &);
+    PointsToNodeSet getReturnValues(const Function *);
+    LivenessSet computeFunctionExitLiveness(const CallInst *, const LivenessSet *);
+    PointsToRelation replaceActualArgumentsWithFormal(const Function *, const CallInst *, const PointsToRelation *);
     LivenessSet replaceFormalArgumentsWithActual(const CallString &CS, const Function *, const CallInst *, LivenessSet &, LivenessSet &);
-    PointsToRelation replaceReturnValuesWithCallInst(const CallInst *, PointsToRelation &, std::set<PointsToNode *> &, LivenessSet &);
-    void runOnFunction(const Function *, const CallString &, IntraproceduralPointsTo *, PointsToRelation &, LivenessSet &, bool, SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> &);
+    PointsToRelation replaceReturnValuesWithCallInst(const CallInst *, PointsToRelation &, PointsToNodeSet &, const LivenessSet &);
+    const PointsToRelation *withTopLevel(const PointsToRelation *, const PointsToRelation *, const LivenessSet &);
+    bool splitTopLevel(const Function *, const PointsToRelation *, const LivenessSet &, const PointsToRelation *&, const PointsToRelation *&, LivenessSet &);
+    bool readsSummaryStatus(const Instruction *, const PointsToRelation &, const LivenessSet &, const SmallPtrSetImpl<PointsToNode *> &);
+    void findSummaryStatusReaders(const Function *, const IntraproceduralPointsTo *, const SolverState &, ArrayRef<PointsToNode *>, SmallVectorImpl<unsigned> &);
+    bool isUntouchedGlobal(const Function *, PointsToNode *);
+    bool factorGlobals(const Function *, const IntraproceduralPointsTo *, PointsToRelation &, LivenessSet &);
+    bool runOnFunction(const Function *, const CallString &, IntraproceduralPointsTo *, const PointsToRelation &, const LivenessSet &, bool, SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> &);
     bool runOnFunctionAt(const CallString &, const Function *, PointsToRelation &, LivenessSet &, bool, bool);
+    CallString getCallString(const CallString &, const Instruction *, const Function *) const;
+    bool isMergedAway(const Function *, const CallString &) const;
+    bool callsMergedFunction(ArrayRef<const Function *>) const;
+    bool countIteration(const Function *, const CallString &);
+    void stopAnalysis(const Twine &);
+    void runWithValueContexts(Module &, ArrayRef<Function *>);
+    void getRoots(Module &, SmallVectorImpl<Function *> &);
+    IntraproceduralPointsTo *findConvergedContext(const CallString &, const Function *, const CallBoundary &);
+    void addConvergedContexts();
     void addNotInvalidatedRestricted(PointsToRelation &, PointsToRelation *, CallInst *, LivenessSet *);
     LivenessSet getInvalidatedNodes(PointsToRelation *, CallInst *);
+    DenseMap<const IntraproceduralPointsTo *, std::unique_ptr<SolverState>> solverStates;
+    // The converged contexts of the earlier roots, by their function and
+    // boundary information. The calls of the current root are kept with
+    // their call strings until it converges, along with the calls that were
+    // given the map of one of the converged contexts.
+    DenseMap<std::pair<const Function *, std::pair<const PointsToRelation *, const LivenessSet *>>, SmallVector<ConvergedContext, 1>> convergedContexts;
+    DenseMap<std::pair<const Function *, const CallStringNode *>, CallString> rootCalls;
+    DenseSet<std::pair<const Function *, const CallStringNode *>> sharedCalls;
+    // The functions that went over -lfcpa-function-budget. The calls to them
+    // from anywhere but the roots share a context for each call site.
+    DenseSet<const Function *> mergedFunctions;
+    DenseMap<const Function *, unsigned> functionIterations;
+    // Whether the analysis stopped before reaching a fixed point because it
+    // went over one of the budgets for the module. Its facts are then
+    // missing pairs, so they aren't used to answer queries.
+    bool incomplete;
+    std::chrono::steady_clock::time_point startTime;
+    unsigned startIterations;
+    CallGraphSCCs callGraph;
+    CallStringTable callStrings;
+    GlobalModRef globalModRef;
+    UnificationPointsTo unification;
+    FactTable facts;
     PointsToData data;
     PointsToNodeFactory factory;
 };
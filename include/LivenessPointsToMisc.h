@@ -38,4 +38,38 @@ inline bool canHandleBitcast(const BitCastInst *I) {
     return false;
 }
 
+// Returns true if calls to the declaration Called don't change what anything
+// points to.
+bool isConstant(const Function *Called);
+
+inline bool mayHoldPointer(const Type *T) {
+    return T->getScalarType()->isPointerTy() || T->isAggregateType();
+}
+
+// Returns true if the transfer functions can do more at I than pass the facts
+// from its neighbours through, either because it is handled specially or
+// because it uses or defines something that may hold a pointer.
+inline bool isPointerRelevant(const Instruction *I) {
+    if (isa<LoadInst>(I) || isa<StoreInst>(I) || isa<CallInst>(I) || isa<AllocaInst>(I) ||
+        isa<PHINode>(I) || isa<SelectInst>(I) || isa<GetElementPtrInst>(I) || isa<BitCastInst>(I))
+        return true;
+
+    if (mayHoldPointer(I->getType()))
+        return true;
+
+    for (const Value *Op : I->operands())
+        if (mayHoldPointer(Op->getType()))
+            return true;
+
+    return false;
+}
+
+// Returns true if the facts at I are stored when facts are only kept at block
+// boundaries and pointer-relevant instructions. At any other instruction, lin
+// is the lin of the next stored instruction and aout is the aout of the
+// previous one restricted to it.
+inline bool isFactStoredAt(const Instruction *I) {
+    return I == &I->getParent()->front() || isa<TerminatorInst>(I) || isPointerRelevant(I);
+}
+
 #endif
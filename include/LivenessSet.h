@@ -1,92 +1,199 @@
 #ifndef LFCPA_LIVENESSSET_H
 #define LFCPA_LIVENESSSET_H
 
-#include <set>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
 
 #include "PointsToNode.h"
 
+#ifdef LFCPA_USE_BDDS
+#include "BDDLivenessSet.h"
+#else
+// A set of nodes, stored by node ID. While a set has at most SmallSize
+// elements, the nodes are kept in an inline array sorted by ID. Larger sets are
+// stored as a bitvector over node IDs, so that unions, comparisons and subset
+// checks can be done a word at a time. Only the range of words between the
+// lowest and highest set bits is stored. In both representations the nodes
+// are iterated over in order of increasing ID.
 class LivenessSet {
     public:
-        typedef std::set<PointsToNode *>::iterator iterator;
-        typedef std::set<PointsToNode *>::const_iterator const_iterator;
-        typedef std::set<PointsToNode *>::size_type size_type;
+        typedef unsigned size_type;
+
+        class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef PointsToNode* value_type;
+            typedef signed difference_type;
+            typedef PointsToNode* const* pointer;
+            typedef PointsToNode* reference;
+
+            const_iterator(const LivenessSet *S, unsigned Pos) : S(S), Pos(Pos) {}
+
+            inline reference operator*() const {
+                return S->large ? PointsToNode::getById(Pos) : S->small[Pos];
+            }
+
+            inline bool operator==(const const_iterator &Y) const {
+                return Pos == Y.Pos;
+            }
+            inline bool operator!=(const const_iterator &Y) const {
+                return !operator==(Y);
+            }
+
+            const_iterator &operator++() {
+                if (S->large)
+                    Pos = S->findNextBit(Pos + 1);
+                else if (++Pos == S->small.size())
+                    Pos = End;
+                return *this;
+            }
+        private:
+            // In the small representation Pos is an index into the array; in
+            // the large representation it is the ID of the current node.
+            const LivenessSet *S;
+            unsigned Pos;
+        };
+        typedef const_iterator iterator;
+
+        LivenessSet() : count(0), large(false), firstWord(0) {}
 
         inline const_iterator begin() const {
-            return s.begin();
+            if (large)
+                return const_iterator(this, findNextBit(firstWord * BitsPerWord));
+            return const_iterator(this, small.empty() ? End : 0);
         }
 
         inline const_iterator find(PointsToNode *N) const {
-            return s.find(N);
+            if (large)
+                return const_iterator(this, testBit(N->getId()) ? N->getId() : End);
+            auto I = std::lower_bound(small.begin(), small.end(), N, PointsToNodeLess());
+            if (I == small.end() || *I != N)
+                return end();
+            return const_iterator(this, I - small.begin());
         }
 
         inline const_iterator end() const {
-            return s.end();
+            return const_iterator(this, End);
         }
 
         inline bool empty() const {
-            return s.empty();
+            return count == 0;
         }
 
         inline int size() const {
-            return s.size();
+            return count;
         }
 
         inline void clear() {
-            s.clear();
+            small.clear();
+            words.clear();
+            firstWord = 0;
+            count = 0;
+            large = false;
         }
 
         inline size_type erase(PointsToNode *N) {
             // When we kill a node, it's children (i.e. GEPs) are also killed.
             for (PointsToNode *Child : N->children) {
                 assert(isa<GEPPointsToNode>(Child) && "All children of PointsToNodes should be GEPs");
-                s.erase(Child);
+                eraseNode(Child);
             }
 
-            return s.erase(N);
+            size_type result = eraseNode(N);
+            if (large && count <= SmallSize / 2)
+                makeSmall();
+            return result;
         }
 
         inline bool insert(PointsToNode *N) {
             if (N->singlePointee() || (!N->hasPointerType() && !N->isAlwaysSummaryNode()) || isa<UnknownPointsToNode>(N))
                 return false;
 
-            return s.insert(N).second;
+            if (large) {
+                if (!setBit(N->getId()))
+                    return false;
+            }
+            else {
+                auto I = std::lower_bound(small.begin(), small.end(), N, PointsToNodeLess());
+                if (I != small.end() && *I == N)
+                    return false;
+                if (small.size() < SmallSize)
+                    small.insert(I, N);
+                else {
+                    makeLarge();
+                    setBit(N->getId());
+                }
+            }
+            ++count;
+            return true;
         }
 
-        inline void insertAll(LivenessSet &L) {
-            s.insert(L.begin(), L.end());
-        }
+        void insertAll(const LivenessSet &L);
 
-        inline bool operator==(const LivenessSet &R) const {
-            return s==R.s;
-        }
+        bool operator==(const LivenessSet &R) const;
 
         inline bool operator!=(const LivenessSet &R) const {
-            return s!=R.s;
+            return !operator==(R);
         }
 
         void dump() const;
 
-        bool isSubset(LivenessSet &S) {
-            for (auto N : S) {
-                if (N->isAlwaysSummaryNode())
-                    continue;
+        // The hash only depends on the nodes in the set, not on which
+        // representation is used.
+        unsigned hash() const;
 
-                if (s.find(N) == s.end())
-                    return false;
-            }
-            return true;
+        bool isSubset(const LivenessSet &S) const;
+
+        void eraseNonSummaryNodes(const CallString &CS);
+    private:
+        static const unsigned SmallSize = 8;
+        static const unsigned BitsPerWord = 64;
+        static const unsigned End = UINT_MAX;
+
+        unsigned count;
+        bool large;
+        // The small representation: the nodes in the set, sorted by ID.
+        SmallVector<PointsToNode *, SmallSize> small;
+        // The large representation: words[i] holds the bits for the IDs in
+        // word firstWord + i. The first and last words are never zero.
+        unsigned firstWord;
+        SmallVector<uint64_t, 2> words;
+
+        inline unsigned endWord() const {
+            return firstWord + words.size();
+        }
+
+        inline bool testBit(unsigned Id) const {
+            unsigned W = Id / BitsPerWord;
+            if (W < firstWord || W >= endWord())
+                return false;
+            return (words[W - firstWord] >> (Id % BitsPerWord)) & 1;
         }
 
-        void eraseNonSummaryNodes(const CallString &CS) {
-            for (auto I = s.begin(), E = s.end(); I != E; ) {
-                if (!(*I)->isSummaryNode(CS))
-                    I = s.erase(I);
-                else
-                    ++I;
+        inline unsigned findNextBit(unsigned Id) const {
+            unsigned W = std::max(Id / BitsPerWord, firstWord);
+            if (W * BitsPerWord > Id)
+                Id = W * BitsPerWord;
+            for (; W < endWord(); ++W, Id = W * BitsPerWord) {
+                uint64_t Bits = words[W - firstWord] >> (Id % BitsPerWord);
+                if (Bits != 0)
+                    return Id + countTrailingZeros(Bits);
             }
+            return End;
         }
-    private:
-        std::set<PointsToNode *> s;
+
+        bool setBit(unsigned Id);
+        bool clearBit(unsigned Id);
+        void growToInclude(unsigned First, unsigned EndW);
+        void trim();
+        size_type eraseNode(PointsToNode *N);
+        void makeLarge();
+        void makeSmall();
 };
+#endif
 
 #endif
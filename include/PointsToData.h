@@ -1,12 +1,16 @@
 #ifndef LFCPA_POINTSTODATA_H
 #define LFCPA_POINTSTODATA_H
 
+#include <memory>
 #include <set>
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Function.h"
 
 #include "CallString.h"
+#include "FactTable.h"
+#include "FlowGraph.h"
 #include "LivenessSet.h"
 #include "PointsToNode.h"
 #include "PointsToRelation.h"
@@ -14,22 +18,68 @@
 using namespace llvm;
 
 typedef std::tuple<CallInst *, Function *, PointsToRelation *, LivenessSet, bool> CallData;
-typedef DenseMap<const Instruction *, std::pair<LivenessSet *, PointsToRelation *>> IntraproceduralPointsTo;
-typedef SmallVector<std::tuple<CallString, IntraproceduralPointsTo *, PointsToRelation, LivenessSet>, 8> ProcedurePointsTo;
+// The sets in the map are interned in a FactTable, so they are immutable and
+// can be compared by pointer.
+typedef DenseMap<const Instruction *, std::pair<const LivenessSet *, const PointsToRelation *>> IntraproceduralPointsTo;
+typedef SmallVector<std::tuple<CallString, IntraproceduralPointsTo *, const PointsToRelation *, const LivenessSet *>, 8> ProcedurePointsTo;
 
 bool arePointsToMapsEqual(const Function *F, IntraproceduralPointsTo *a, IntraproceduralPointsTo &b);
-IntraproceduralPointsTo copyPointsToMap(IntraproceduralPointsTo *);
+
+// Indexes the entries of a ProcedurePointsTo. Entries with non-cyclic call
+// strings are found by the trie node of the call string; cyclic ones are
+// indexed by the node of their non-cyclic part, so the cyclic entries that
+// can match a call string are found by looking up each of its prefixes.
+struct ContextIndex {
+    DenseMap<const CallStringNode *, unsigned> exact;
+    DenseMap<const CallStringNode *, SmallVector<unsigned, 1>> cyclic;
+};
 
 class PointsToData {
     public:
-        PointsToData() {}
+        PointsToData(FactTable &Facts) : facts(Facts) {}
         ProcedurePointsTo *getAtFunction(const Function *) const;
-        IntraproceduralPointsTo *getPointsTo(const CallString &, const Function *, PointsToRelation &, LivenessSet &, bool &);
+        IntraproceduralPointsTo *getPointsTo(const CallString &, const Function *, const PointsToRelation *&, const LivenessSet *&, bool &, bool &);
+        IntraproceduralPointsTo *getValueContext(const CallString &, const Function *, const PointsToRelation *, const LivenessSet *, bool, function_ref<bool(const Function *)>, IntraproceduralPointsTo *&, bool &);
+        void removeValueContexts(const SmallPtrSetImpl<const IntraproceduralPointsTo *> &);
+        void shareContext(const CallString &, const Function *, IntraproceduralPointsTo *, const PointsToRelation *, const LivenessSet *);
+        void removeContext(const CallString &, const Function *);
         bool attemptMakeCyclicCallString(const Function *, const CallString &, IntraproceduralPointsTo *);
         bool hasDataForFunction(const Function *) const;
         IntraproceduralPointsTo *get(const Function *, const CallString &) const;
+        const FlowGraph &getFlowGraph(const Function *);
+        std::pair<const LivenessSet *, const PointsToRelation *> getFactsAt(const IntraproceduralPointsTo *, const Instruction *);
+        const PointsToRelation *getTopLevel(const IntraproceduralPointsTo *) const;
+        void setTopLevel(const IntraproceduralPointsTo *, const PointsToRelation *);
+        std::pair<const LivenessSet *, const PointsToRelation *> getUntouchedGlobals(const IntraproceduralPointsTo *) const;
+        void setUntouchedGlobals(const IntraproceduralPointsTo *, const LivenessSet *, const PointsToRelation *);
+        void expandFacts(const Function *, IntraproceduralPointsTo *) const;
+        void compactFacts(const Function *, IntraproceduralPointsTo *) const;
     private:
         DenseMap<const Function *, ProcedurePointsTo *> data;
+        // Returned for the functions that have no entry in data.
+        mutable ProcedurePointsTo noContexts;
+        DenseMap<const Function *, ContextIndex> index;
+        DenseMap<const Function *, std::unique_ptr<FlowGraph>> graphs;
+        // The pairs of the SSA pointers that are kept out of the
+        // per-instruction relations, for each call string's map.
+        DenseMap<const IntraproceduralPointsTo *, const PointsToRelation *> topLevel;
+        // The globals that are live at the exit of each map's function but that
+        // it can't access, with their pairs at its entry. They are the same at
+        // every instruction, so they are kept out of the per-instruction facts
+        // (see -lfcpa-factor-globals).
+        DenseMap<const IntraproceduralPointsTo *, std::pair<const LivenessSet *, const PointsToRelation *>> untouchedGlobals;
+        // Whether the return value is live at the exit, for the maps of the
+        // truncated call strings, whose boundaries are merged, and of the
+        // value contexts.
+        DenseMap<const IntraproceduralPointsTo *, bool> returnValuesLive;
+        // The value contexts of each function, by their boundary information.
+        DenseMap<const Function *, DenseMap<std::pair<const PointsToRelation *, const LivenessSet *>, SmallVector<unsigned, 1>>> valueContexts;
+        FactTable &facts;
+
+        IntraproceduralPointsTo *createFacts(const Function *);
+        std::pair<const LivenessSet *, const PointsToRelation *> getStoredFactsAt(const IntraproceduralPointsTo *, const Instruction *);
+        void reindex(const Function *);
+        int findCyclicMatch(const ContextIndex &, const ProcedurePointsTo &, const CallString &) const;
 };
 
 #endif
@@ -1,7 +1,9 @@
 #ifndef LFCPA_POINTSTONODE_H
 #define LFCPA_POINTSTONODE_H
 
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Constants.h"
@@ -28,6 +30,7 @@ public:
         PTNK_Value,
         PTNK_Global,
         PTNK_NoAlias,
+        PTNK_Placeholder,
         PTNK_GEP
     };
     friend class GEPPointsToNode;
@@ -36,15 +39,41 @@ public:
     friend class LivenessPointsTo;
 private:
     const PointsToNodeKind Kind;
+    // Every node is given a dense ID when it is created, so that sets of nodes
+    // can be stored as bitvectors indexed by ID, and so that nodes are
+    // ordered the same way in every run. IDs are reused once the nodes with
+    // the highest IDs have been destroyed, so each analysis numbers its nodes
+    // from zero. The table is shared by every factory in the process, since the
+    // sets and relations map IDs back to nodes without knowing which factory
+    // made them. Two analyses may be alive at once (their IDs then interleave),
+    // but they must not run on different threads.
+    unsigned id;
+    static std::vector<PointsToNode *> nodesById;
 protected:
     StringRef name;
+    // Numbers the unnamed values for printing. It is shared in the same way
+    // and never reset, so the names depend on what was analysed before.
     static int nextId;
     bool summaryNode = false, summaryNodePointees = false, fieldSensitive = true;
 
-    PointsToNode(PointsToNodeKind K) : Kind(K) {}
+    PointsToNode(PointsToNodeKind K) : Kind(K), id(nodesById.size()) {
+        nodesById.push_back(this);
+    }
+    // Nodes are owned by a PointsToNodeFactory and destroyed with it.
+    ~PointsToNode() {
+        nodesById[id] = nullptr;
+        while (!nodesById.empty() && nodesById.back() == nullptr)
+            nodesById.pop_back();
+    }
 public:
     SmallVector<PointsToNode *, 4> children;
     PointsToNodeKind getKind() const { return Kind; }
+    inline unsigned getId() const { return id; }
+    static inline PointsToNode *getById(unsigned Id) {
+        assert(Id < nodesById.size());
+        return nodesById[Id];
+    }
+    static inline unsigned getNumIds() { return nodesById.size(); }
 
     virtual bool hasPointerType() const { return false; }
     virtual bool multipleStackFrames() const { return false; }
@@ -100,6 +129,16 @@ public:
     }
 };
 
+// Orders nodes by ID rather than by address, so that the order in which sets of
+// nodes are iterated over matches the order of the bits in a LivenessSet.
+struct PointsToNodeLess {
+    inline bool operator()(const PointsToNode *A, const PointsToNode *B) const {
+        return A->getId() < B->getId();
+    }
+};
+
+typedef std::set<PointsToNode *, PointsToNodeLess> PointsToNodeSet;
+
 class UnknownPointsToNode : public PointsToNode {
     private:
         std::string stdName;
@@ -138,8 +177,15 @@ class ValuePointsToNode : public PointsToNode {
         bool isPointer, userOrArg;
         PointsToNode *Pointee;
     public:
-        ValuePointsToNode(const Value *V, PointsToNode *Pointee) : PointsToNode(PTNK_Value), Pointee(Pointee) {
+        // The function whose instruction or argument this is the node for, or
+        // nullptr for constants.
+        const Function *Definer;
+        ValuePointsToNode(const Value *V, PointsToNode *Pointee) : PointsToNode(PTNK_Value), Pointee(Pointee), Definer(nullptr) {
             assert(V != nullptr);
+            if (const Instruction *I = dyn_cast<Instruction>(V))
+                Definer = I->getParent()->getParent();
+            else if (const Argument *A = dyn_cast<Argument>(V))
+                Definer = A->getParent();
             name = V->getName();
             if (name == "") {
                 stdName = std::to_string(nextId++);
@@ -179,6 +225,7 @@ class GlobalPointsToNode : public PointsToNode {
         }
 
         bool hasPointerType() const override { return isPointer; }
+        const GlobalObject *getObject() const { return Object; }
 
         const Function *getFunction() const override {
             if (const Function *F = dyn_cast<Function>(Object)) {
@@ -249,6 +296,32 @@ class NoAliasPointsToNode : public PointsToNode {
         }
 };
 
+// Stands for an object of a caller in the boundary information of a value
+// context that is shared between calls (see -lfcpa-summaries). Each call that
+// is bound to the context maps the placeholders back to its own objects.
+class PlaceholderPointsToNode : public PointsToNode {
+    private:
+        std::string stdName;
+        bool isPointer;
+    public:
+        // Whether the node was a summary node when it was created, rather than
+        // being turned into one while a context was analysed.
+        const bool createdAsSummaryNode;
+        PlaceholderPointsToNode(unsigned Number, bool Pointer, bool Summary, bool FieldSensitive) : PointsToNode(PTNK_Placeholder), isPointer(Pointer), createdAsSummaryNode(Summary) {
+            stdName = "param:" + std::to_string(Number);
+            name = StringRef(stdName);
+            summaryNode = Summary;
+            fieldSensitive = FieldSensitive;
+        }
+
+        bool hasPointerType() const override { return isPointer; }
+        bool multipleStackFrames() const override { return true; }
+
+        static bool classof(const PointsToNode *N) {
+            return N->getKind() == PTNK_Placeholder;
+        }
+};
+
 class GEPPointsToNode : public PointsToNode {
     public:
         const PointsToNode *Parent;
@@ -1,21 +1,34 @@
 #ifndef LFCPA_POINTSTONODEFACTORY_H
 #define LFCPA_POINTSTONODEFACTORY_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Support/Allocator.h"
 
 #include "PointsToNode.h"
 
+// Creates and owns every node used by an analysis. Nodes are allocated in
+// arenas (one for each kind of node) and are all destroyed with the factory.
 class PointsToNodeFactory {
     private:
+        SpecificBumpPtrAllocator<ValuePointsToNode> valueNodes;
+        SpecificBumpPtrAllocator<GlobalPointsToNode> globalNodes;
+        SpecificBumpPtrAllocator<NoAliasPointsToNode> noAliasNodes;
+        SpecificBumpPtrAllocator<GEPPointsToNode> gepNodes;
+        SpecificBumpPtrAllocator<PlaceholderPointsToNode> placeholderNodes;
         DenseMap<const Value *, PointsToNode *> map;
         DenseMap<const Value *, PointsToNode *> noAliasMap;
         DenseMap<const GlobalObject *, PointsToNode *> globalMap;
+        DenseMap<unsigned, PointsToNode *> placeholderMap;
+        unsigned numPlaceholders = 0;
+        SmallVector<PointsToNode *, 16> summaryNodes;
         UnknownPointsToNode unknown;
         InitPointsToNode init;
         bool matchGEPNode(const GEPOperator *, const PointsToNode *) const;
-        PointsToNode *getGEPNode(const GEPOperator *, const Type *Type, PointsToNode *, PointsToNode *) const;
+        PointsToNode *getGEPNode(const GEPOperator *, const Type *Type, PointsToNode *, PointsToNode *);
     public:
         PointsToNode *getUnknown();
         PointsToNode *getInit();
@@ -24,6 +37,20 @@ class PointsToNodeFactory {
         PointsToNode *getNoAliasNode(const CallInst *);
         PointsToNode *getGlobalNode(const GlobalObject *);
         PointsToNode *getIndexedNode(PointsToNode *, const GEPOperator *);
+        // Returns the Index'th placeholder with the given type, summary node
+        // status and field-sensitivity. If that placeholder has been turned
+        // into a summary node since, a new one is made to replace it.
+        PointsToNode *getPlaceholder(unsigned Index, bool Pointer, bool Summary, bool FieldSensitive);
+        // Creates a new child of Parent with the given indices. The node is
+        // added to Parent's list of children.
+        PointsToNode *makeChildNode(PointsToNode *Parent, const Type *Type, const SmallVector<APInt, 8> &Indices, PointsToNode *Pointee);
+        // Turns N into a summary node. The facts that were computed while it
+        // wasn't one may be wrong, so the nodes that this happens to are
+        // recorded for the analysis to look for.
+        void markAsSummaryNode(PointsToNode *N);
+        // The nodes that have been turned into summary nodes (other than as
+        // they were created), in the order that it happened.
+        ArrayRef<PointsToNode *> getSummaryNodes() const { return summaryNodes; }
 };
 
 #endif
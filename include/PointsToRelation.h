@@ -1,15 +1,72 @@
 #ifndef LFCPA_POINTSTORELATION_H
 #define LFCPA_POINTSTORELATION_H
 
-#include <set>
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 
 #include "LivenessSet.h"
 #include "PointsToNode.h"
 
+// Orders pairs by the IDs of their components, which is the order that the
+// nodes in a LivenessSet are iterated over in.
+struct PointsToPairLess {
+    inline bool operator()(const std::pair<PointsToNode *, PointsToNode *> &A, const std::pair<PointsToNode *, PointsToNode *> &B) const {
+        if (A.first != B.first)
+            return A.first->getId() < B.first->getId();
+        return A.second->getId() < B.second->getId();
+    }
+};
+
+#ifdef LFCPA_USE_BDDS
+#include "BDDPointsToRelation.h"
+#else
+// The relation is stored as a map from the ID of each pointer to the list of
+// its pointees (sorted by ID), so finding the pointees of a node takes constant
+// time, and iterating over the pointees of a set of nodes takes time
+// proportional to the number of pairs found.
 class PointsToRelation {
 public:
-    typedef std::set<std::pair<PointsToNode *, PointsToNode *>> container;
-    typedef container::const_iterator const_iterator;
+    typedef SmallVector<PointsToNode *, 2> PointeeList;
+    typedef DenseMap<unsigned, PointeeList> container;
+    typedef PointsToNodeSet NodeSet;
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<PointsToNode *, PointsToNode *> value_type;
+        typedef signed difference_type;
+        typedef std::pair<PointsToNode *, PointsToNode *> const* pointer;
+        typedef std::pair<PointsToNode *, PointsToNode *> const& reference;
+
+        const_iterator(container::const_iterator I, container::const_iterator E) : I(I), E(E), Index(0) {
+            if (I != E)
+                Current = std::make_pair(PointsToNode::getById(I->first), I->second[0]);
+        }
+
+        inline reference operator*() const { return Current; }
+        inline pointer operator->() const { return &operator*(); }
+
+        inline bool operator==(const const_iterator &Y) const {
+            return I == Y.I && Index == Y.Index;
+        }
+        inline bool operator !=(const const_iterator &Y) const {
+            return !operator==(Y);
+        }
+
+        const_iterator &operator++() {
+            if (++Index == I->second.size()) {
+                ++I;
+                Index = 0;
+            }
+            if (I != E)
+                Current = std::make_pair(PointsToNode::getById(I->first), I->second[Index]);
+            return *this;
+        }
+    private:
+        container::const_iterator I, E;
+        unsigned Index;
+        std::pair<PointsToNode *, PointsToNode *> Current;
+    };
 
     class const_pointee_iterator {
     public:
@@ -19,16 +76,11 @@ public:
         typedef PointsToNode* const* pointer;
         typedef PointsToNode* const& reference;
 
-        const_pointee_iterator(const_iterator I, const_iterator E, const PointsToNode *N) : single_value(false), E(E), Value(nullptr), N(N) {
-            while (I != E && I->first != N) {
-                ++I;
-            }
-            this->I = I;
-        }
+        const_pointee_iterator(PointsToNode *const *I, PointsToNode *const *E) : single_value(false), I(I), E(E), Value(nullptr) {}
 
-        const_pointee_iterator(PointsToNode *Value) : single_value(true), Value(Value) {}
+        const_pointee_iterator(PointsToNode *Value) : single_value(true), I(nullptr), E(nullptr), Value(Value) {}
 
-        inline reference operator*() const { return single_value ? Value : I->second; }
+        inline reference operator*() const { return single_value ? Value : *I; }
         inline pointer operator->() const { return &operator*(); }
 
         inline bool operator==(const const_pointee_iterator &Y) const {
@@ -36,7 +88,7 @@ public:
             if (single_value)
                 return Value == Y.Value;
             else
-                return I == Y.I || (I == E && Y.I == Y.E);
+                return I == Y.I;
         }
         inline bool operator !=(const const_pointee_iterator &Y) const {
             return !operator==(Y);
@@ -47,25 +99,22 @@ public:
                 assert(Value);
                 Value = nullptr;
             }
-            else {
-                do {
-                    ++I;
-                } while (I != E && I->first != N);
-            }
+            else
+                ++I;
             return *this;
         }
 
         inline bool atEnd() const { return single_value ? Value == nullptr : I == E; }
     private:
-        // This is very ugly -- it essentially implemented two different
-        // iterators with one class. However, it is significantly simpler than
-        // any alternatives.
+        // Nodes that always have a single pointee have no entry in the
+        // relation, so the iterator either walks over a list of pointees or
+        // returns the single pointee.
         bool single_value;
-        const_iterator I, E;
+        PointsToNode *const *I, *const *E;
         PointsToNode *Value;
-        const PointsToNode *N;
     };
 
+    template <typename DomainIterator>
     class const_restriction_iterator {
     public:
         typedef std::forward_iterator_tag iterator_category;
@@ -74,23 +123,17 @@ public:
         typedef std::pair<PointsToNode *, PointsToNode *> const* pointer;
         typedef std::pair<PointsToNode *, PointsToNode *> const& reference;
 
-        const_restriction_iterator(const_iterator I, const_iterator E, std::set<PointsToNode *>::const_iterator DI, std::set<PointsToNode *>::const_iterator DE) : I(I), E(E), DI(DI), DE(DE), useSinglePointee(false) {
+        const_restriction_iterator(const container *S, DomainIterator DI, DomainIterator DE) : S(S), DI(DI), DE(DE), I(nullptr), E(nullptr), loaded(false), useSinglePointee(false) {
             advance_iterators();
         }
 
-        inline reference operator*() const {
-            if (useSinglePointee)
-                return singlePointeePair;
-            else
-                return *I;
-        }
+        inline reference operator*() const { return current; }
         inline pointer operator->() const { return &operator*(); }
 
         inline bool operator==(const const_restriction_iterator &Y) const {
-            if (useSinglePointee)
-                return Y.useSinglePointee && singlePointeePair == Y.singlePointeePair;
-            else
-                return !Y.useSinglePointee && (I == Y.I || (I == E && Y.I == Y.E));
+            if (DI != Y.DI)
+                return false;
+            return DI == DE || (useSinglePointee == Y.useSinglePointee && I == Y.I);
         }
         inline bool operator !=(const const_restriction_iterator &Y) const {
             return !operator==(Y);
@@ -98,8 +141,8 @@ public:
 
         const_restriction_iterator &operator++() {
             if (useSinglePointee) {
-                useSinglePointee = false;
                 ++DI;
+                loaded = false;
             }
             else
                 ++I;
@@ -107,45 +150,49 @@ public:
             return *this;
         }
 
-        inline bool atEnd() const { return I == E; }
+        inline bool atEnd() const { return DI == DE; }
     private:
         inline void advance_iterators() {
-            assert(!useSinglePointee);
-            // Increment I zero or more times, until its first component is in
-            // DI..DE (or until the end is reached), and advance DI until it
-            // reaches I (or until the end is reached).
-            std::less<PointsToNode *> l;
-            while (I != E && DI != DE && I->first != *DI) {
-                // Advance DI until it is greater than or equal to I->first, or
-                // a value that has a single pointee is found.
-                while (DI != DE && !(*DI)->singlePointee() && l(*DI, I->first)) ++DI;
-                if (DI == DE)
-                    break;
-                else if ((*DI)->singlePointee()) {
-                    useSinglePointee = true;
-                    singlePointeePair = std::make_pair(*DI, (*DI)->getSinglePointee());
-                    break;
+            // Advance DI until it reaches a node that has a pointee, and set
+            // I..E to the pointees of that node.
+            for (; DI != DE; ++DI, loaded = false) {
+                PointsToNode *N = *DI;
+                if (!loaded) {
+                    loaded = true;
+                    useSinglePointee = N->singlePointee();
+                    if (useSinglePointee) {
+                        current = std::make_pair(N, N->getSinglePointee());
+                        return;
+                    }
+                    auto Found = S->find(N->getId());
+                    if (Found != S->end()) {
+                        I = Found->second.begin();
+                        E = Found->second.end();
+                    }
+                    else
+                        I = E = nullptr;
+                }
+                if (I != E) {
+                    current = std::make_pair(N, *I);
+                    return;
                 }
-                // Advance I until I->first is greater than or equal to DI.
-                while (I != E && l(I->first, *DI)) ++I;
             }
-
-            if (DI == DE)
-                I = E;
         }
 
-        const_iterator I, E;
-        std::set<PointsToNode *>::const_iterator DI, DE;
-        bool useSinglePointee;
-        std::pair<PointsToNode *, PointsToNode *> singlePointeePair;
+        const container *S;
+        DomainIterator DI, DE;
+        PointsToNode *const *I, *const *E;
+        bool loaded, useSinglePointee;
+        std::pair<PointsToNode *, PointsToNode *> current;
     };
 
-    inline void insertAll(PointsToRelation &R) {
-        s.insert(R.s.begin(), R.s.end());
-    }
+    PointsToRelation() : count(0) {}
+
+    void insertAll(const PointsToRelation &R);
 
     inline void clear() {
         s.clear();
+        count = 0;
     }
 
     inline bool insert(const std::pair<PointsToNode *, PointsToNode *> &N) {
@@ -159,119 +206,102 @@ public:
         if (isa<UnknownPointsToNode>(N.first) || (!N.first->hasPointerType() && !N.first->isAlwaysSummaryNode()))
             return false;
 
-        return s.insert(N).second;
+        PointeeList &L = s[N.first->getId()];
+        auto I = std::lower_bound(L.begin(), L.end(), N.second, PointsToNodeLess());
+        if (I != L.end() && *I == N.second)
+            return false;
+        L.insert(I, N.second);
+        ++count;
+        return true;
     }
 
-    inline void unionRelationRestriction(PointsToRelation &R, LivenessSet &S) {
-        auto RI = R.s.begin(), RE = R.s.end();
-        auto SI = S.begin(), SE = S.end();
-        auto I = s.begin(), E = s.end();
-        std::less<PointsToNode *> ln;
-        std::less<std::pair<PointsToNode *, PointsToNode *>> l;
-
-        while (RI != RE && SI != SE) {
-            // Find the first element of R that needs inserting.
-            while (*SI != RI->first) {
-                while (SI != SE && ln(*SI, RI->first)) ++SI;
-                if (SI == SE) return;
-                while (RI != RE && ln(RI->first, *SI)) ++RI;
-                if (RI == RE) return;
-            }
-            // At this point, *SI == RI->first, and neither iterator has reached
-            // the end.
-
-            // Find the position to insert the next value at.
-            while (I != E && l(*I, *RI)) ++I;
+    void unionRelationRestriction(const PointsToRelation &R, const LivenessSet &S);
 
-            s.emplace_hint(I, *RI);
-            ++RI;
-        }
-    }
-
-    inline bool operator==(const PointsToRelation &R) const {
-        return s==R.s;
-    }
+    bool operator==(const PointsToRelation &R) const;
 
     inline bool operator!=(const PointsToRelation &R) const {
-        return s!=R.s;
+        return !operator==(R);
     }
 
-    inline const_pointee_iterator pointee_begin(const PointsToNode *N) {
+    inline const_pointee_iterator pointee_begin(const PointsToNode *N) const {
         if (N->singlePointee())
             return const_pointee_iterator(N->getSinglePointee());
-        else
-            return const_pointee_iterator(s.begin(), s.end(), N);
+        auto I = s.find(N->getId());
+        if (I == s.end())
+            return const_pointee_iterator(nullptr, nullptr);
+        return const_pointee_iterator(I->second.begin(), I->second.end());
     }
 
-    inline const_pointee_iterator pointee_end(const PointsToNode *N) {
+    inline const_pointee_iterator pointee_end(const PointsToNode *N) const {
         if (N->singlePointee())
             return const_pointee_iterator(nullptr);
-        else
-            return const_pointee_iterator(s.end(), s.end(), N);
+        auto I = s.find(N->getId());
+        if (I == s.end())
+            return const_pointee_iterator(nullptr, nullptr);
+        return const_pointee_iterator(I->second.end(), I->second.end());
     }
 
-    inline const_restriction_iterator restriction_begin(const std::set<PointsToNode *>& S) {
-        return const_restriction_iterator(s.begin(), s.end(), S.begin(), S.end());
+    inline const_restriction_iterator<NodeSet::const_iterator> restriction_begin(const NodeSet &S) const {
+        return const_restriction_iterator<NodeSet::const_iterator>(&s, S.begin(), S.end());
     }
 
-    inline const_restriction_iterator restriction_end(const std::set<PointsToNode *>& S) {
-        return const_restriction_iterator(s.end(), s.end(), S.begin(), S.end());
+    inline const_restriction_iterator<NodeSet::const_iterator> restriction_end(const NodeSet &S) const {
+        return const_restriction_iterator<NodeSet::const_iterator>(&s, S.end(), S.end());
     }
 
-    inline const_restriction_iterator restriction_begin(const LivenessSet &S) {
-        return const_restriction_iterator(s.begin(), s.end(), S.begin(), S.end());
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_begin(const LivenessSet &S) const {
+        return const_restriction_iterator<LivenessSet::const_iterator>(&s, S.begin(), S.end());
     }
 
-    inline const_restriction_iterator restriction_end(const LivenessSet &S) {
-        return const_restriction_iterator(s.end(), s.end(), S.begin(), S.end());
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_end(const LivenessSet &S) const {
+        return const_restriction_iterator<LivenessSet::const_iterator>(&s, S.end(), S.end());
     }
 
-    inline const_restriction_iterator restriction_begin(const LivenessSet *S) {
-        return const_restriction_iterator(s.begin(), s.end(), S->begin(), S->end());
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_begin(const LivenessSet *S) const {
+        return restriction_begin(*S);
     }
 
-    inline const_restriction_iterator restriction_end(const LivenessSet *S) {
-        return const_restriction_iterator(s.end(), s.end(), S->begin(), S->end());
+    inline const_restriction_iterator<LivenessSet::const_iterator> restriction_end(const LivenessSet *S) const {
+        return restriction_end(*S);
     }
 
-    inline const_iterator begin() {
-        return s.begin();
+    inline const_iterator begin() const {
+        return const_iterator(s.begin(), s.end());
     }
 
-    inline const_iterator end() {
-        return s.end();
+    inline const_iterator end() const {
+        return const_iterator(s.end(), s.end());
     }
 
     inline bool empty() const {
-        return s.empty();
+        return count == 0;
     }
 
-    bool isSubset(PointsToRelation &R) {
-        for (auto P : R.s) {
-            if (P.first->isAlwaysSummaryNode())
-                continue;
-
-            bool found = false;
-            for (auto Q : s) {
-                if (Q == P)
-                    found = true;
-            }
-            if (!found)
-                return false;
-        }
-        return true;
+    inline unsigned size() const {
+        return count;
     }
 
-    inline void insertEverythingInto(LivenessSet &S) {
-        for (auto P : s) {
-            S.insert(P.first);
-            S.insert(P.second);
+    bool isSubset(const PointsToRelation &R) const;
+
+    // The hash does not depend on the order in which pairs were inserted.
+    unsigned hash() const;
+
+    inline void insertEverythingInto(LivenessSet &S) const {
+        for (auto &P : s) {
+            S.insert(PointsToNode::getById(P.first));
+            for (PointsToNode *Pointee : P.second)
+                S.insert(Pointee);
         }
     }
 
     void dump() const;
 private:
     container s;
+    // The number of pairs in the relation.
+    unsigned count;
+
+    void unionPointees(unsigned Id, const PointeeList &Pointees);
 };
+#endif
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef LFCPA_UNIFICATIONPOINTSTO_H
+#define LFCPA_UNIFICATIONPOINTSTO_H
+
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+using namespace llvm;
+
+// A flow- and context-insensitive points-to analysis in the style of
+// Steensgaard's, which is run over the whole module before the main analysis
+// (see -lfcpa-unification). The values are partitioned into classes, and the
+// values in a class may point to the objects in one other class, so an
+// assignment merges the classes of what its two sides point to. Whatever
+// code outside the module can reach is merged into a single unknown class.
+// The analysis is nearly linear in the size of the module, so it is used to
+// find the functions that indirect calls may reach before the main analysis
+// knows what the called pointers point to.
+class UnificationPointsTo {
+    public:
+        void compute(const Module &M);
+
+        // Sets Callees to the functions that CI may call and returns true, or
+        // returns false if code outside the module may have made the called
+        // pointer, it can't point to any function, or the analysis wasn't
+        // run.
+        bool getCallees(const CallInst *CI, SmallVectorImpl<const Function *> &Callees) const;
+        // Returns false if A and B can't point to the same object.
+        bool mayAlias(const Value *A, const Value *B) const;
+    private:
+        struct Class {
+            unsigned parent, size;
+            // The class of the objects that the values in the class may point
+            // to, or NoClass if nothing has been stored in them yet.
+            unsigned pointee;
+            bool unknown;
+            SmallVector<const Function *, 2> functions;
+        };
+        static const unsigned NoClass = ~0u;
+
+        std::vector<Class> classes;
+        // The class of what each value points to, and of what each function
+        // returns.
+        DenseMap<const Value *, unsigned> values;
+        DenseMap<const Function *, unsigned> returns;
+        unsigned unknownClass;
+
+        unsigned createClass();
+        unsigned find(unsigned C) const;
+        void join(unsigned A, unsigned B);
+        unsigned getPointee(unsigned C);
+        unsigned getClass(const Value *V);
+        unsigned getReturnClass(const Function *F);
+        void addInstruction(const Instruction *I, SmallVectorImpl<const CallInst *> &IndirectCalls);
+        void addCall(const CallInst *CI, const Function *F);
+        void addUnknownCall(const CallInst *CI);
+};
+
+#endif
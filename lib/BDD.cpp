@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/ErrorHandling.h"
+
+#include "BDD.h"
+
+using namespace llvm;
+
+static const unsigned NumVars = 2 * BDD_DOMAIN_BITS;
+static const unsigned False = 0, True = 1;
+
+// Owns the nodes of every BDD. Nodes are hash-consed through the unique table,
+// so two BDDs represent the same function if and only if they have the same
+// root. The results of recent operations are remembered in a direct-mapped
+// cache.
+class BDDManager {
+    public:
+        // The manager is never destroyed, since BDDs may be held by objects
+        // that are destroyed after it would be. There is one for the whole
+        // process, since BDDs are built from node IDs, which are shared too
+        // (see PointsToNode), so BDDs must only be used from one thread.
+        static BDDManager &get() {
+            static BDDManager *M = new BDDManager();
+            return *M;
+        }
+
+        inline void ref(unsigned N) {
+            if (N > True)
+                ++nodes[N].refs;
+        }
+
+        inline void deref(unsigned N) {
+            if (N > True) {
+                assert(nodes[N].refs > 0);
+                --nodes[N].refs;
+            }
+        }
+
+        inline unsigned child(unsigned N, unsigned Var, unsigned Bit) const {
+            const Node &X = nodes[N];
+            if (X.var != Var)
+                return N;
+            return Bit ? X.high : X.low;
+        }
+
+        // Nodes are only reclaimed between operations, since the
+        // intermediate results of an operation are not referenced by any
+        // handle.
+        void maybeCollect();
+
+        unsigned makeNode(unsigned Var, unsigned Low, unsigned High);
+        unsigned element(unsigned Id, unsigned FirstVar, unsigned Below);
+
+        enum Op { And, Or, Diff, Domain, Range, Shift };
+        unsigned apply(Op O, unsigned A, unsigned B);
+        unsigned domain(unsigned A);
+        unsigned range(unsigned A);
+        unsigned shift(unsigned A);
+        unsigned cofactor(unsigned A, unsigned Id) const;
+        uint64_t count(unsigned A, unsigned Lo, unsigned Hi) const;
+    private:
+        struct Node {
+            unsigned var, low, high;
+            // The next node in the same unique table bucket, or the next
+            // free node.
+            unsigned next;
+            // The number of handles that refer to this node.
+            unsigned refs;
+        };
+
+        struct CacheEntry {
+            unsigned op, a, b, result;
+        };
+
+        static const unsigned FreeVar = ~0u;
+        static const unsigned CacheSize = 1 << 18;
+
+        std::vector<Node> nodes;
+        std::vector<unsigned> buckets;
+        std::vector<CacheEntry> cache;
+        unsigned freeList, live, gcThreshold;
+
+        BDDManager();
+
+        static inline unsigned hashTriple(unsigned X, unsigned Y, unsigned Z) {
+            return (X * 12582917u) ^ (Y * 4256249u) ^ (Z * 741457u) ^ (Z >> 7);
+        }
+
+        inline bool lookupCache(unsigned O, unsigned A, unsigned B, unsigned &Result) const {
+            const CacheEntry &E = cache[hashTriple(O, A, B) & (CacheSize - 1)];
+            if (E.op != O || E.a != A || E.b != B)
+                return false;
+            Result = E.result;
+            return true;
+        }
+
+        inline unsigned storeCache(unsigned O, unsigned A, unsigned B, unsigned Result) {
+            CacheEntry &E = cache[hashTriple(O, A, B) & (CacheSize - 1)];
+            E.op = O;
+            E.a = A;
+            E.b = B;
+            E.result = Result;
+            return Result;
+        }
+
+        void rehash(unsigned NumBuckets);
+        void collect();
+
+        inline unsigned level(unsigned N, unsigned Hi) const {
+            return std::min(nodes[N].var, Hi);
+        }
+
+        // The number of assignments to the variables from N's variable up to
+        // Hi that satisfy N.
+        uint64_t countFrom(unsigned N, unsigned Hi, DenseMap<unsigned, uint64_t> &Counts) const;
+};
+
+BDDManager::BDDManager() : freeList(0), live(0), gcThreshold(1 << 18) {
+    // The terminals sit below every variable.
+    Node Terminal = {NumVars, False, False, 0, 0};
+    nodes.push_back(Terminal);
+    Terminal.low = Terminal.high = True;
+    nodes.push_back(Terminal);
+    buckets.assign(1 << 12, 0);
+    CacheEntry Empty = {~0u, 0, 0, 0};
+    cache.assign(CacheSize, Empty);
+}
+
+void BDDManager::rehash(unsigned NumBuckets) {
+    buckets.assign(NumBuckets, 0);
+    for (unsigned I = True + 1, E = nodes.size(); I != E; ++I) {
+        Node &X = nodes[I];
+        if (X.var == FreeVar)
+            continue;
+        unsigned H = hashTriple(X.var, X.low, X.high) & (NumBuckets - 1);
+        X.next = buckets[H];
+        buckets[H] = I;
+    }
+}
+
+unsigned BDDManager::makeNode(unsigned Var, unsigned Low, unsigned High) {
+    if (Low == High)
+        return Low;
+
+    unsigned H = hashTriple(Var, Low, High) & (buckets.size() - 1);
+    for (unsigned I = buckets[H]; I != 0; I = nodes[I].next) {
+        const Node &X = nodes[I];
+        if (X.var == Var && X.low == Low && X.high == High)
+            return I;
+    }
+
+    Node X = {Var, Low, High, buckets[H], 0};
+    unsigned I;
+    if (freeList != 0) {
+        I = freeList;
+        freeList = nodes[I].next;
+        nodes[I] = X;
+    }
+    else {
+        I = nodes.size();
+        nodes.push_back(X);
+    }
+    buckets[H] = I;
+    if (++live > buckets.size())
+        rehash(buckets.size() * 2);
+    return I;
+}
+
+void BDDManager::maybeCollect() {
+    if (live < gcThreshold)
+        return;
+    collect();
+    // If most of the nodes are still in use, let the table grow.
+    if (live > gcThreshold / 2)
+        gcThreshold *= 2;
+}
+
+void BDDManager::collect() {
+    std::vector<bool> Marked(nodes.size(), false);
+    std::vector<unsigned> Stack;
+    for (unsigned I = True + 1, E = nodes.size(); I != E; ++I)
+        if (nodes[I].var != FreeVar && nodes[I].refs > 0)
+            Stack.push_back(I);
+    while (!Stack.empty()) {
+        unsigned I = Stack.back();
+        Stack.pop_back();
+        if (I <= True || Marked[I])
+            continue;
+        Marked[I] = true;
+        Stack.push_back(nodes[I].low);
+        Stack.push_back(nodes[I].high);
+    }
+
+    for (unsigned I = True + 1, E = nodes.size(); I != E; ++I) {
+        Node &X = nodes[I];
+        if (X.var == FreeVar || Marked[I])
+            continue;
+        X.var = FreeVar;
+        X.next = freeList;
+        freeList = I;
+        --live;
+    }
+
+    rehash(buckets.size());
+    CacheEntry Empty = {~0u, 0, 0, 0};
+    cache.assign(CacheSize, Empty);
+}
+
+unsigned BDDManager::element(unsigned Id, unsigned FirstVar, unsigned Below) {
+    assert(Id < (1u << BDD_DOMAIN_BITS) && "Too many nodes for BDD_DOMAIN_BITS.");
+    unsigned R = Below;
+    for (unsigned I = BDD_DOMAIN_BITS; I-- != 0; ) {
+        unsigned Bit = (Id >> (BDD_DOMAIN_BITS - 1 - I)) & 1;
+        R = Bit ? makeNode(FirstVar + I, False, R) : makeNode(FirstVar + I, R, False);
+    }
+    return R;
+}
+
+unsigned BDDManager::apply(Op O, unsigned A, unsigned B) {
+    switch (O) {
+        case And:
+            if (A == False || B == False)
+                return False;
+            if (A == True || A == B)
+                return B;
+            if (B == True)
+                return A;
+            if (A > B)
+                std::swap(A, B);
+            break;
+        case Or:
+            if (A == True || B == True)
+                return True;
+            if (A == False || A == B)
+                return B;
+            if (B == False)
+                return A;
+            if (A > B)
+                std::swap(A, B);
+            break;
+        case Diff:
+            if (A == False || B == True || A == B)
+                return False;
+            if (B == False)
+                return A;
+            break;
+        default:
+            llvm_unreachable("Not a binary operation.");
+    }
+
+    unsigned Result;
+    if (lookupCache(O, A, B, Result))
+        return Result;
+
+    unsigned VA = nodes[A].var, VB = nodes[B].var, V = std::min(VA, VB);
+    unsigned Low = apply(O, VA == V ? nodes[A].low : A, VB == V ? nodes[B].low : B);
+    unsigned High = apply(O, VA == V ? nodes[A].high : A, VB == V ? nodes[B].high : B);
+    return storeCache(O, A, B, makeNode(V, Low, High));
+}
+
+unsigned BDDManager::domain(unsigned A) {
+    if (A <= True)
+        return A;
+    // Every node is satisfiable, so a node that only tests the second
+    // component's variables has some second component.
+    if (nodes[A].var >= BDD_DOMAIN_BITS)
+        return True;
+
+    unsigned Result;
+    if (lookupCache(Domain, A, 0, Result))
+        return Result;
+    unsigned Low = domain(nodes[A].low);
+    unsigned High = domain(nodes[A].high);
+    return storeCache(Domain, A, 0, makeNode(nodes[A].var, Low, High));
+}
+
+unsigned BDDManager::range(unsigned A) {
+    if (A <= True)
+        return A;
+    if (nodes[A].var >= BDD_DOMAIN_BITS)
+        return shift(A);
+
+    unsigned Result;
+    if (lookupCache(Range, A, 0, Result))
+        return Result;
+    unsigned Low = range(nodes[A].low);
+    unsigned High = range(nodes[A].high);
+    return storeCache(Range, A, 0, apply(Or, Low, High));
+}
+
+unsigned BDDManager::shift(unsigned A) {
+    if (A <= True)
+        return A;
+
+    unsigned Result;
+    if (lookupCache(Shift, A, 0, Result))
+        return Result;
+    assert(nodes[A].var >= BDD_DOMAIN_BITS);
+    unsigned Low = shift(nodes[A].low);
+    unsigned High = shift(nodes[A].high);
+    return storeCache(Shift, A, 0, makeNode(nodes[A].var - BDD_DOMAIN_BITS, Low, High));
+}
+
+unsigned BDDManager::cofactor(unsigned A, unsigned Id) const {
+    for (unsigned I = 0; I != BDD_DOMAIN_BITS && A != False; ++I)
+        A = child(A, I, (Id >> (BDD_DOMAIN_BITS - 1 - I)) & 1);
+    return A;
+}
+
+uint64_t BDDManager::countFrom(unsigned N, unsigned Hi, DenseMap<unsigned, uint64_t> &Counts) const {
+    if (N <= True)
+        return N;
+    auto I = Counts.find(N);
+    if (I != Counts.end())
+        return I->second;
+
+    const Node &X = nodes[N];
+    uint64_t Low = countFrom(X.low, Hi, Counts) << (level(X.low, Hi) - X.var - 1);
+    uint64_t High = countFrom(X.high, Hi, Counts) << (level(X.high, Hi) - X.var - 1);
+    return Counts[N] = Low + High;
+}
+
+uint64_t BDDManager::count(unsigned A, unsigned Lo, unsigned Hi) const {
+    DenseMap<unsigned, uint64_t> Counts;
+    return countFrom(A, Hi, Counts) << (level(A, Hi) - Lo);
+}
+
+BDD::BDD(unsigned Root) : root(Root) {
+    BDDManager::get().ref(root);
+}
+
+BDD::BDD(const BDD &Other) : root(Other.root) {
+    BDDManager::get().ref(root);
+}
+
+BDD &BDD::operator=(const BDD &Other) {
+    BDDManager &M = BDDManager::get();
+    M.ref(Other.root);
+    M.deref(root);
+    root = Other.root;
+    return *this;
+}
+
+BDD::~BDD() {
+    BDDManager::get().deref(root);
+}
+
+BDD BDD::element(unsigned Id) {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.element(Id, 0, True));
+}
+
+BDD BDD::pair(unsigned First, unsigned Second) {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.element(First, 0, M.element(Second, BDD_DOMAIN_BITS, True)));
+}
+
+BDD BDD::operator|(const BDD &Other) const {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.apply(BDDManager::Or, root, Other.root));
+}
+
+BDD BDD::operator&(const BDD &Other) const {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.apply(BDDManager::And, root, Other.root));
+}
+
+BDD BDD::operator-(const BDD &Other) const {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.apply(BDDManager::Diff, root, Other.root));
+}
+
+BDD BDD::cofactor(unsigned First) const {
+    return BDD(BDDManager::get().cofactor(root, First));
+}
+
+bool BDD::contains(unsigned Id) const {
+    return BDDManager::get().cofactor(root, Id) == True;
+}
+
+BDD BDD::domain() const {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.domain(root));
+}
+
+BDD BDD::range() const {
+    BDDManager &M = BDDManager::get();
+    M.maybeCollect();
+    return BDD(M.range(root));
+}
+
+uint64_t BDD::count(unsigned Lo, unsigned Hi) const {
+    return BDDManager::get().count(root, Lo, Hi);
+}
+
+BDDIterator::BDDIterator(const BDD &B, unsigned Lo, unsigned Hi) : lo(Lo), depth(Hi - Lo), bits(0) {
+    nodes.resize(depth + 1);
+    nodes[0] = B.root;
+    done = !search(0, 0);
+}
+
+BDDIterator::BDDIterator(const BDD &B, unsigned Lo, unsigned Hi, uint64_t Value) : lo(Lo), depth(Hi - Lo), done(false), bits(Value) {
+    BDDManager &M = BDDManager::get();
+    nodes.resize(depth + 1);
+    nodes[0] = B.root;
+    for (unsigned K = 0; K != depth; ++K) {
+        nodes[K + 1] = M.child(nodes[K], lo + K, (Value >> (depth - 1 - K)) & 1);
+        assert(nodes[K + 1] != False && "The value does not satisfy the BDD.");
+    }
+}
+
+void BDDIterator::next() {
+    assert(!done);
+    done = !search(depth - 1, (bits & 1) + 1);
+}
+
+// Finds the next satisfying assignment that agrees with the current one on
+// the first K variables and assigns at least FirstBit to variable K.
+bool BDDIterator::search(unsigned K, unsigned FirstBit) {
+    BDDManager &M = BDDManager::get();
+    for (;;) {
+        if (K == depth)
+            return true;
+
+        unsigned Bit = FirstBit;
+        for (; Bit < 2; ++Bit)
+            if (M.child(nodes[K], lo + K, Bit) != False)
+                break;
+
+        uint64_t Mask = uint64_t(1) << (depth - 1 - K);
+        if (Bit < 2) {
+            nodes[K + 1] = M.child(nodes[K], lo + K, Bit);
+            bits = Bit ? bits | Mask : bits & ~Mask;
+            ++K;
+            FirstBit = 0;
+            continue;
+        }
+
+        if (K == 0)
+            return false;
+        --K;
+        FirstBit = ((bits >> (depth - 1 - K)) & 1) + 1;
+    }
+}
@@ -0,0 +1,32 @@
+#include "llvm/Support/raw_ostream.h"
+
+#include "LivenessSet.h"
+
+bool LivenessSet::isSubset(const LivenessSet &S) const {
+    // Only the nodes that are in S but not in this set need to be looked at.
+    LivenessSet Missing;
+    Missing.s = S.s - s;
+    for (auto N : Missing)
+        if (!N->isAlwaysSummaryNode())
+            return false;
+    return true;
+}
+
+void LivenessSet::eraseNonSummaryNodes(const CallString &CS) {
+    BDD Erased;
+    for (auto N : *this)
+        if (!N->isSummaryNode(CS))
+            Erased = Erased | BDD::element(N->getId());
+    s = s - Erased;
+}
+
+void LivenessSet::dump() const {
+    bool first = true;
+    for (auto N : *this) {
+        if (!first)
+            errs() << ", ";
+        first = false;
+        errs() << N->getName();
+    }
+    errs() << "\n";
+}
@@ -0,0 +1,32 @@
+#include "llvm/Support/raw_ostream.h"
+
+#include "PointsToRelation.h"
+
+bool PointsToRelation::isSubset(const PointsToRelation &R) const {
+    // Only the pointers of the pairs that are in R but not in this relation
+    // need to be looked at.
+    BDD Missing = (R.s - s).domain();
+    for (BDDIterator I(Missing, 0, BDD_DOMAIN_BITS); !I.atEnd(); I.next())
+        if (!PointsToNode::getById(I.value())->isAlwaysSummaryNode())
+            return false;
+    return true;
+}
+
+void PointsToRelation::insertEverythingInto(LivenessSet &S) const {
+    BDD Domain = s.domain(), Range = s.range();
+    for (BDDIterator I(Domain, 0, BDD_DOMAIN_BITS); !I.atEnd(); I.next())
+        S.insert(PointsToNode::getById(I.value()));
+    for (BDDIterator I(Range, 0, BDD_DOMAIN_BITS); !I.atEnd(); I.next())
+        S.insert(PointsToNode::getById(I.value()));
+}
+
+void PointsToRelation::dump() const {
+    bool first = true;
+    for (auto P : *this) {
+        if (!first)
+            errs() << ", ";
+        first = false;
+        errs() << P.first->getName() << "-->" << P.second->getName();
+    }
+    errs() << "\n";
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+#include "CallGraphSCCs.h"
+
+void CallGraphSCCs::addDirectCalls(const Module &M, const UnificationPointsTo &Unification) {
+    for (const Function &F : M) {
+        if (F.isDeclaration())
+            continue;
+        callees[&F];
+        for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+            if (const CallInst *CI = dyn_cast<CallInst>(&*I)) {
+                SmallVector<const Function *, 8> Called;
+                if (const Function *G = CI->getCalledFunction())
+                    Called.push_back(G);
+                else
+                    Unification.getCallees(CI, Called);
+                for (const Function *G : Called)
+                    if (!G->isDeclaration())
+                        addCall(&F, G);
+            }
+        }
+    }
+}
+
+void CallGraphSCCs::addCall(const Function *Caller, const Function *Callee) {
+    SmallVector<const Function *, 4> &C = callees[Caller];
+    if (std::find(C.begin(), C.end(), Callee) == C.end()) {
+        C.push_back(Callee);
+        callees[Callee];
+        changed = true;
+        reachable.clear();
+    }
+}
+
+bool CallGraphSCCs::isRecursive(const Function *F) {
+    if (changed)
+        computeComponents();
+
+    auto Found = components.find(F);
+    return Found == components.end() || cyclic[Found->second];
+}
+
+bool CallGraphSCCs::mayCall(const Function *Caller, const Function *Callee) {
+    auto Found = reachable.find(Caller);
+    if (Found == reachable.end()) {
+        SmallPtrSet<const Function *, 16> &Reached = reachable[Caller];
+        SmallVector<const Function *, 16> Stack(1, Caller);
+        while (!Stack.empty()) {
+            auto C = callees.find(Stack.pop_back_val());
+            if (C == callees.end())
+                continue;
+            for (const Function *F : C->second)
+                if (Reached.insert(F).second)
+                    Stack.push_back(F);
+        }
+        return Reached.count(Callee) != 0;
+    }
+    return Found->second.count(Callee) != 0;
+}
+
+// Tarjan's algorithm. Returns the lowest number reachable from F through
+// functions that are still on the stack.
+unsigned CallGraphSCCs::visit(const Function *F, DenseMap<const Function *, unsigned> &Numbers, SmallVectorImpl<const Function *> &Stack, unsigned &Next) {
+    unsigned Number = Next++, Low = Number;
+    Numbers[F] = Number;
+    Stack.push_back(F);
+
+    bool CallsItself = false;
+    for (const Function *Callee : callees.find(F)->second) {
+        if (Callee == F)
+            CallsItself = true;
+        auto Found = Numbers.find(Callee);
+        if (Found == Numbers.end())
+            Low = std::min(Low, visit(Callee, Numbers, Stack, Next));
+        else if (components.find(Callee) == components.end())
+            Low = std::min(Low, Found->second);
+    }
+
+    if (Low == Number) {
+        // F is the root of a component, which is made up of the functions
+        // above it on the stack.
+        unsigned Component = cyclic.size();
+        bool Cyclic = CallsItself || Stack.back() != F;
+        const Function *Member;
+        do {
+            Member = Stack.pop_back_val();
+            components[Member] = Component;
+        } while (Member != F);
+        cyclic.push_back(Cyclic);
+    }
+    return Low;
+}
+
+void CallGraphSCCs::computeComponents() {
+    components.clear();
+    cyclic.clear();
+    DenseMap<const Function *, unsigned> Numbers;
+    SmallVector<const Function *, 32> Stack;
+    unsigned Next = 0;
+    for (auto &C : callees)
+        if (Numbers.find(C.first) == Numbers.end())
+            visit(C.first, Numbers, Stack, Next);
+    changed = false;
+}
@@ -1,114 +1,211 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "CallGraphSCCs.h"
 #include "CallString.h"
 
-CallString CallString::empty() {
-    return CallString();
+static cl::opt<unsigned> CallStringLimit("lfcpa-k",
+    cl::desc("Keep only the last k calls of each call string (0 means no limit)"),
+    cl::init(0));
+
+CallStringNode::CallStringNode(CallStringTable *Table, const CallStringNode *Parent, const Instruction *Call) : table(Table), parent(Parent), call(Call), depth(0), truncated(false), unique(false) {
+    if (Parent != nullptr) {
+        depth = Parent->depth + 1;
+        truncated = Parent->truncated;
+        unique = Parent->unique;
+        calls = Parent->calls;
+        unsigned &Count = calls[Call->getParent()->getParent()];
+        if (Count < 2)
+            ++Count;
+    }
+}
+
+const CallStringNode *CallStringTable::getChild(const CallStringNode *N, const Instruction *Call) {
+    const CallStringNode *&Child = N->children[Call];
+    if (Child == nullptr)
+        Child = new (allocator.Allocate()) CallStringNode(this, N, Call);
+    return Child;
+}
+
+// Returns a node for the same calls as N that isn't in the trie, so no other
+// node is equal to it or to its children.
+const CallStringNode *CallStringTable::getCopy(const CallStringNode *N) {
+    assert(N->parent != nullptr && "The root can't be copied");
+    CallStringNode *Copy = new (allocator.Allocate()) CallStringNode(this, N->parent, N->call);
+    Copy->unique = true;
+    return Copy;
+}
+
+// Returns the string made up of the last Limit - 1 calls of N followed by
+// Call, which is truncated. If N is unique, so is the string.
+const CallStringNode *CallStringTable::getShifted(const CallStringNode *N, const Instruction *Call, unsigned Limit) {
+    const CallStringNode *&Shifted = N->shifted[Call];
+    if (Shifted != nullptr)
+        return Shifted;
+
+    SmallVector<const Instruction *, 8> Calls;
+    for (const CallStringNode *C = N; C->depth != 0 && Calls.size() + 1 < Limit; C = C->parent)
+        Calls.push_back(C->call);
+
+    const CallStringNode *S = &truncatedRoot;
+    for (auto I = Calls.rbegin(), E = Calls.rend(); I != E; ++I)
+        S = getChild(S, *I);
+    Shifted = getChild(S, Call);
+    if (N->unique)
+        Shifted = getCopy(Shifted);
+    return Shifted;
+}
+
+// Returns the truncated string that is made up of just Call.
+const CallStringNode *CallStringTable::getTruncated(const Instruction *Call) {
+    return getChild(&truncatedRoot, Call);
+}
+
+bool CallStringTable::isRecursive(const Function *F) const {
+    return callGraph.isRecursive(F);
 }
 
 CallString CallString::addCallSite(const Instruction *I) const {
-    CallString result = *this;
-    result.nonCyclic.push_back(I);
-    return result;
+    CallStringTable *Table = nonCyclic->table;
+    if (CallStringLimit != 0 && nonCyclic->depth >= CallStringLimit)
+        return CallString(Table->getShifted(nonCyclic, I, CallStringLimit), cyclic);
+    return CallString(Table->getChild(nonCyclic, I), cyclic);
+}
+
+// Returns the string for the call I that forgets the calls before it, so
+// that the calls through I from every call string share it. This is the
+// string that -lfcpa-k=1 would give the call.
+CallString CallString::addMergedCallSite(const Instruction *I) const {
+    return CallString(nonCyclic->table->getTruncated(I), cyclic);
+}
+
+// Returns a string made up of the same calls that is different from all of the
+// other strings, as are the strings that are made by adding calls to it.
+CallString CallString::makeUnique() const {
+    return CallString(nonCyclic->table->getCopy(nonCyclic), cyclic);
 }
 
 bool CallString::isNonCyclicPrefix(const CallString &S) const {
-    auto thisIter = nonCyclic.begin();
-    auto thisEnd = nonCyclic.end();
-    for (auto &I : S.nonCyclic) {
-        if (thisIter == thisEnd) {
-            // S is longer!
-            return false;
-        }
-        else if (I != *thisIter) {
-            // S contains a different element.
-            return false;
-        }
-        else
-            thisIter++;
-    }
-    return thisIter != thisEnd;
+    if (S.nonCyclic->depth >= nonCyclic->depth)
+        return false;
+
+    const CallStringNode *N = nonCyclic;
+    while (N->depth > S.nonCyclic->depth)
+        N = N->parent;
+    return N == S.nonCyclic;
 }
 
 CallString CallString::createCyclicFromPrefix(const CallString &S) const {
-    auto thisIter = nonCyclic.begin();
-    auto thisEnd = nonCyclic.end();
-    for (auto &I : S.nonCyclic) {
-        thisIter++;
-        // Supress unused variable warning in non-asserts builds.
-        (void)I;
-    }
+    SmallVector<const Instruction *, 8> Suffix;
+    for (const CallStringNode *N = nonCyclic; N->depth > S.nonCyclic->depth; N = N->parent)
+        Suffix.push_back(N->call);
 
-    CallString result = S;
-    result.cyclic = SmallVector<const Instruction *, 8>(thisIter, thisEnd);
-    return result;
+    CallStringTable *Table = nonCyclic->table;
+    const CallStringNode *Cyclic = Table->empty().nonCyclic;
+    for (auto I = Suffix.rbegin(), E = Suffix.rend(); I != E; ++I)
+        Cyclic = Table->getChild(Cyclic, *I);
+    return CallString(S.nonCyclic, Cyclic);
 }
 
 bool CallString::matches(const CallString &S) const {
+    const CallStringNode *N = S.nonCyclic;
+    if (!isCyclic())
+        return N == nonCyclic;
 
-    auto iter = S.nonCyclic.begin();
-    auto end = S.nonCyclic.end();
-    for (auto &I : nonCyclic) {
-        if (iter == end) {
-            // S isn't long enough!
-            return false;
-        }
-        else if (I != *iter) {
-            // S contains a different element.
+    // S must be the non-cyclic part followed by a whole number of copies of
+    // the cyclic part, so compare the calls from the end of S.
+    if (N->depth < nonCyclic->depth || (N->depth - nonCyclic->depth) % cyclic->depth != 0)
+        return false;
+
+    const CallStringNode *C = cyclic;
+    while (N->depth > nonCyclic->depth) {
+        if (N->call != C->call)
             return false;
-        }
-        else
-            iter++;
+        N = N->parent;
+        C = C->parent;
+        if (C->depth == 0)
+            C = cyclic;
     }
+    return N == nonCyclic;
+}
 
-    if (isCyclic()) {
-        while (iter != end) {
-            for (auto &I : cyclic) {
-                if (iter == end) {
-                    // S has an incomplete cyclic part at the end.
-                    return false;
-                }
-                else if (I != *iter) {
-                    // S contains a different element.
-                    return false;
-                }
-                else
-                    iter++;
-            }
-        }
+// Returns the first call of the non-cyclic part, which must not be empty.
+const Instruction *CallString::getFirstCall() const {
+    assert(nonCyclic->depth != 0 && "The string has no calls");
+    const CallStringNode *N = nonCyclic;
+    while (N->depth > 1)
+        N = N->parent;
+    return N->call;
+}
 
+bool CallString::containsCallIn(const Function *F) const {
+    if (nonCyclic->callsIn(F) != 0 || cyclic->callsIn(F) != 0)
         return true;
-    }
-    else
-        return iter == end;
+    return nonCyclic->truncated && nonCyclic->table->isRecursive(F);
 }
 
-void CallString::dump() const {
+bool CallString::reachedMoreThanOnce(const Function *F) const {
+    if (nonCyclic->truncated && nonCyclic->table->isRecursive(F))
+        return true;
+    unsigned Calls = nonCyclic->callsIn(F);
+    if (Calls != 1)
+        return Calls > 1;
+
+    // This is imprecise because the last call may not actually be a call to
+    // F if getCalledFunction is nullptr, but it is safe.
+    const Function *Last = getLastCalledFunction();
+    return Last == nullptr || Last == F;
+}
+
+// Returns true if the summary nodes can't tell S from this string: both have
+// the same number of calls (up to 2) in each function that Relevant holds for,
+// the same last called function and are both truncated or both not.
+bool CallString::reachesSameFunctions(const CallString &S, function_ref<bool(const Function *)> Relevant) const {
+    const CallStringNode *N = nonCyclic, *M = S.nonCyclic;
+    if (N == M)
+        return true;
+    if (N->truncated != M->truncated || getLastCalledFunction() != S.getLastCalledFunction())
+        return false;
+
+    for (auto &C : N->calls)
+        if (Relevant(C.first) && M->callsIn(C.first) != C.second)
+            return false;
+    for (auto &C : M->calls)
+        if (Relevant(C.first) && N->callsIn(C.first) != C.second)
+            return false;
+    return true;
+}
+
+// Prints the calls on the path from the root to N, separated by commas.
+static void dumpCalls(const CallStringNode *N) {
+    SmallVector<const Instruction *, 8> Calls;
+    for (; N->getDepth() != 0; N = N->getParent())
+        Calls.push_back(N->getCall());
+
     bool first = true;
-    for (auto &I : nonCyclic) {
+    for (auto I = Calls.rbegin(), E = Calls.rend(); I != E; ++I) {
         if (!first)
             errs() << ", ";
-        I->print(errs());
+        (*I)->print(errs());
         first = false;
     }
+}
+
+void CallString::dump() const {
+    if (nonCyclic->truncated)
+        errs() << "..., ";
+    dumpCalls(nonCyclic);
 
     if (isCyclic()) {
-        if (!first)
+        if (nonCyclic->depth != 0)
             errs() << ", ";
         errs() << "[";
-        first = true;
-        for (auto &I : cyclic) {
-            if (!first)
-                errs() << ", ";
-            I->print(errs());
-            first = false;
-        }
+        dumpCalls(cyclic);
         errs() << "]*";
     }
 
     errs() << "\n";
 }
-
@@ -0,0 +1,162 @@
+#include <algorithm>
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
+
+#include "FlowGraph.h"
+#include "LivenessPointsToMisc.h"
+
+static bool isNode(const Function *F, const Instruction *I, bool Sparse) {
+    if (!Sparse)
+        return true;
+
+    // The first instruction and the returns are where the boundary
+    // information is used, so they are always nodes.
+    return I == &F->front().front() || isa<ReturnInst>(I) || isPointerRelevant(I);
+}
+
+// Inserts N into the sorted vector V if it isn't already in it.
+static void insertSorted(SmallVectorImpl<unsigned> &V, unsigned N) {
+    auto I = std::lower_bound(V.begin(), V.end(), N);
+    if (I == V.end() || *I != N)
+        V.insert(I, N);
+}
+
+static bool insertAllSorted(SmallVectorImpl<unsigned> &V, ArrayRef<unsigned> From) {
+    unsigned Size = V.size();
+    for (unsigned N : From)
+        insertSorted(V, N);
+    return V.size() != Size;
+}
+
+FlowGraph::FlowGraph(const Function *F, bool Sparse) {
+    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (isNode(F, &*I, Sparse)) {
+            numbers[&*I] = instructions.size();
+            instructions.push_back(&*I);
+        }
+    }
+    successors.resize(instructions.size());
+    predecessors.resize(instructions.size());
+
+    // Find the first and last nodes in each block. Blocks without any nodes
+    // pass on the nodes at the boundaries of their neighbours, so these are
+    // propagated until nothing changes.
+    SmallVector<const BasicBlock *, 16> WithoutNodes;
+    for (const BasicBlock &BB : *F) {
+        SmallVector<unsigned, 2> &Entry = entries[&BB], &Exit = exits[&BB];
+        for (const Instruction &I : BB) {
+            auto Found = numbers.find(&I);
+            if (Found != numbers.end()) {
+                if (Entry.empty())
+                    Entry.push_back(Found->second);
+                Exit.assign(1, Found->second);
+            }
+        }
+        if (Entry.empty())
+            WithoutNodes.push_back(&BB);
+    }
+
+    bool Changed = !WithoutNodes.empty();
+    while (Changed) {
+        Changed = false;
+        for (const BasicBlock *BB : WithoutNodes) {
+            for (const_succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI)
+                if (*SI != BB)
+                    Changed |= insertAllSorted(entries[BB], entries[*SI]);
+            for (const_pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI)
+                if (*PI != BB)
+                    Changed |= insertAllSorted(exits[BB], exits[*PI]);
+        }
+    }
+
+    // Connect each node to the next one in its block, and the last node in
+    // each block to the nodes that the successors of the block start with.
+    auto addEdge = [&](unsigned From, unsigned To) {
+        insertSorted(successors[From], To);
+        insertSorted(predecessors[To], From);
+    };
+    for (const BasicBlock &BB : *F) {
+        int Prev = -1;
+        for (const Instruction &I : BB) {
+            auto Found = numbers.find(&I);
+            if (Found == numbers.end())
+                continue;
+            if (Prev != -1)
+                addEdge(Prev, Found->second);
+            Prev = Found->second;
+        }
+
+        if (Prev != -1)
+            for (const_succ_iterator SI = succ_begin(&BB), SE = succ_end(&BB); SI != SE; ++SI)
+                for (unsigned N : entries[*SI])
+                    addEdge(Prev, N);
+    }
+
+    computeRPO();
+}
+
+void FlowGraph::computeRPO() {
+    unsigned Size = instructions.size();
+    SmallVector<unsigned, 128> PostOrder;
+    SmallVector<bool, 128> Visited(Size, false);
+    // Each entry is a node and the index of the next successor to visit.
+    SmallVector<std::pair<unsigned, unsigned>, 32> Stack;
+    if (Size != 0) {
+        Visited[0] = true;
+        Stack.push_back({0, 0});
+    }
+    while (!Stack.empty()) {
+        unsigned N = Stack.back().first;
+        unsigned &NextSucc = Stack.back().second;
+        if (NextSucc == successors[N].size()) {
+            PostOrder.push_back(N);
+            Stack.pop_back();
+            continue;
+        }
+        unsigned Succ = successors[N][NextSucc++];
+        if (!Visited[Succ]) {
+            Visited[Succ] = true;
+            Stack.push_back({Succ, 0});
+        }
+    }
+
+    rpo.assign(PostOrder.rbegin(), PostOrder.rend());
+    for (unsigned N = 0; N != Size; ++N)
+        if (!Visited[N])
+            rpo.push_back(N);
+    rpoNumbers.resize(Size);
+    for (unsigned Position = 0; Position != Size; ++Position)
+        rpoNumbers[rpo[Position]] = Position;
+}
+
+void FlowGraph::getSurroundingNodes(const Instruction *I, SmallVectorImpl<unsigned> &Before, SmallVectorImpl<unsigned> &After) const {
+    assert(!hasNode(I) && "The instruction is a node.");
+    const BasicBlock *BB = I->getParent();
+    BasicBlock::const_iterator Inst(I);
+
+    // Look for a node earlier in the block; if there isn't one, the nodes
+    // before I are those at the ends of the predecessors.
+    bool Found = false;
+    for (BasicBlock::const_iterator P = Inst; !Found && P != BB->begin();) {
+        --P;
+        if (hasNode(&*P)) {
+            Before.push_back(getNode(&*P));
+            Found = true;
+        }
+    }
+    if (!Found)
+        for (const_pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI)
+            insertAllSorted(Before, exits.find(*PI)->second);
+
+    Found = false;
+    for (BasicBlock::const_iterator N = ++Inst; !Found && N != BB->end(); ++N) {
+        if (hasNode(&*N)) {
+            After.push_back(getNode(&*N));
+            Found = true;
+        }
+    }
+    if (!Found)
+        for (const_succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI)
+            insertAllSorted(After, entries.find(*SI)->second);
+}
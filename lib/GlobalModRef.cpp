@@ -0,0 +1,105 @@
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+
+#include "GlobalModRef.h"
+
+// Returns true if the only uses of V (through constant GEPs and casts) are as
+// the pointer operands of loads and stores.
+bool GlobalModRef::isOnlyLoadedAndStored(const Value *V) {
+    for (const User *U : V->users()) {
+        if (const LoadInst *LI = dyn_cast<LoadInst>(U)) {
+            if (LI->getPointerOperand() != V)
+                return false;
+        }
+        else if (const StoreInst *SI = dyn_cast<StoreInst>(U)) {
+            if (SI->getPointerOperand() != V || SI->getValueOperand() == V)
+                return false;
+        }
+        else if (isa<ConstantExpr>(U) && (isa<GEPOperator>(U) || isa<BitCastOperator>(U))) {
+            if (!isOnlyLoadedAndStored(U))
+                return false;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+void GlobalModRef::addUsedGlobals(const Value *V, SmallPtrSetImpl<const GlobalVariable *> &Used, SmallPtrSetImpl<const Constant *> &Visited) {
+    if (const GlobalVariable *G = dyn_cast<GlobalVariable>(V)) {
+        if (tracked.count(G) != 0)
+            Used.insert(G);
+    }
+    else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+        if (Visited.insert(CE).second)
+            for (const Value *Op : CE->operands())
+                addUsedGlobals(Op, Used, Visited);
+    }
+}
+
+void GlobalModRef::compute(const Module &M, const UnificationPointsTo &Unification) {
+    tracked.clear();
+    accessed.clear();
+    accessesAll.clear();
+
+    for (const GlobalVariable &G : M.globals())
+        if (isOnlyLoadedAndStored(&G))
+            tracked.insert(&G);
+
+    // The globals that each function uses itself, and the functions that it
+    // calls.
+    DenseMap<const Function *, SmallPtrSet<const GlobalVariable *, 8>> Used;
+    DenseMap<const Function *, SmallPtrSet<const Function *, 8>> Callees;
+    SmallPtrSet<const Function *, 8> CallsIndirectly;
+    for (const Function &F : M) {
+        if (F.isDeclaration())
+            continue;
+        SmallPtrSet<const Constant *, 16> Visited;
+        for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+            if (const CallInst *CI = dyn_cast<CallInst>(&*I)) {
+                SmallVector<const Function *, 8> Called;
+                if (const Function *G = CI->getCalledFunction())
+                    Called.push_back(G);
+                else if (!CI->isInlineAsm() && !Unification.getCallees(CI, Called))
+                    CallsIndirectly.insert(&F);
+                for (const Function *G : Called)
+                    if (!G->isDeclaration())
+                        Callees[&F].insert(G);
+            }
+            for (const Value *Op : I->operands())
+                addUsedGlobals(Op, Used[&F], Visited);
+        }
+    }
+
+    for (const Function &F : M) {
+        if (F.isDeclaration())
+            continue;
+        SmallPtrSet<const GlobalVariable *, 8> &Accessed = accessed[&F];
+        SmallPtrSet<const Function *, 16> Reached;
+        SmallVector<const Function *, 16> Stack(1, &F);
+        Reached.insert(&F);
+        while (!Stack.empty()) {
+            const Function *G = Stack.pop_back_val();
+            if (CallsIndirectly.count(G) != 0) {
+                accessesAll.insert(&F);
+                break;
+            }
+            auto U = Used.find(G);
+            if (U != Used.end())
+                Accessed.insert(U->second.begin(), U->second.end());
+            auto C = Callees.find(G);
+            if (C != Callees.end())
+                for (const Function *Callee : C->second)
+                    if (Reached.insert(Callee).second)
+                        Stack.push_back(Callee);
+        }
+    }
+}
+
+bool GlobalModRef::mayAccess(const Function *F, const GlobalVariable *G) const {
+    if (tracked.count(G) == 0 || accessesAll.count(F) != 0)
+        return true;
+    auto Found = accessed.find(F);
+    return Found == accessed.end() || Found->second.count(G) != 0;
+}
@@ -24,7 +24,7 @@ struct LivenessBasedAA : public ModulePass, public AliasAnalysis {
         return false;
     }
 
-    bool areAllSubNodes(const std::set<PointsToNode *> A, const std::set<PointsToNode *> B) {
+    bool areAllSubNodes(const PointsToNodeSet A, const PointsToNodeSet B) {
         for (auto N : A)
             for (auto M : B)
                 if (!N->isSubNodeOf(M))
@@ -53,9 +53,14 @@ struct LivenessBasedAA : public ModulePass, public AliasAnalysis {
             return NoAlias;
         }
 
+        // The pointers can't alias if the unification pre-pass put what they
+        // point to in different classes.
+        if (!analysis.mayAliasByUnification(A, B))
+            return NoAlias;
+
         bool allowMustAlias = true;
-        std::set<PointsToNode *> ASet = analysis.getPointsToSet(A, allowMustAlias);
-        std::set<PointsToNode *> BSet = analysis.getPointsToSet(B, allowMustAlias);
+        PointsToNodeSet ASet = analysis.getPointsToSet(A, allowMustAlias);
+        PointsToNodeSet BSet = analysis.getPointsToSet(B, allowMustAlias);
 
         // If either of the sets are empty, then we don't know what one of the
         // values can point to, and therefore we don't know if they can alias.
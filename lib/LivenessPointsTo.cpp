@@ -1,12 +1,15 @@
+#include <algorithm>
+#include <deque>
 #include <set>
+#include <vector>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/BasicBlock.h"
-#include "llvm/IR/CFG.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "LivenessPointsToMisc.h"
@@ -18,12 +21,64 @@
 unsigned LivenessPointsTo::worklistIterations = 0;
 unsigned LivenessPointsTo::timesRanOnFunction = 0;
 
-bool createdSummaryNode = false;
+static cl::opt<bool> TopLevelSSA("lfcpa-ssa-top-level",
+    cl::desc("Keep the pairs of SSA pointers in one relation for each call string rather than at each instruction"),
+    cl::init(false));
+
+static cl::opt<bool> ValueContexts("lfcpa-value-contexts",
+    cl::desc("Share the analysis of a function between the calls that reach it with the same boundary information"),
+    cl::init(false));
+
+static cl::opt<bool> Summaries("lfcpa-summaries",
+    cl::desc("Analyse functions with placeholders for the objects of their callers, sharing value contexts between calls that only differ in the objects they pass (implies -lfcpa-value-contexts)"),
+    cl::init(false));
+
+static cl::opt<bool> FactorGlobals("lfcpa-factor-globals",
+    cl::desc("Keep the facts about the globals that a function and its callees can't access in one record for each context rather than at each instruction"),
+    cl::init(false));
+
+static cl::opt<bool> Unification("lfcpa-unification",
+    cl::desc("Run a unification-based points-to analysis over the module first, and use it to build the call graph and to resolve indirect calls through pointers with unknown pointees"),
+    cl::init(false));
+
+enum RootKind { AllRoots, MainRoot, ExternalRoots };
+
+static cl::opt<RootKind> Roots("lfcpa-roots",
+    cl::desc("The functions to start the analysis from; only the functions that they reach are analysed"),
+    cl::values(
+        clEnumValN(AllRoots, "all", "Every function that is defined in the module"),
+        clEnumValN(MainRoot, "main", "The main function"),
+        clEnumValN(ExternalRoots, "external", "The functions that can be called from outside the module"),
+        clEnumValEnd),
+    cl::init(AllRoots));
+
+static cl::list<std::string> RootNames("lfcpa-root",
+    cl::desc("Start the analysis from the named function, rather than the functions chosen by -lfcpa-roots"),
+    cl::CommaSeparated);
+
+static cl::opt<unsigned> TimeBudget("lfcpa-time-budget",
+    cl::desc("Stop the analysis after this many seconds, and answer queries with the unification pre-pass instead (0 means no limit)"),
+    cl::init(0));
+
+static cl::opt<unsigned> IterationBudget("lfcpa-iteration-budget",
+    cl::desc("Stop the analysis after this many iterations of the worklists, and answer queries with the unification pre-pass instead (0 means no limit)"),
+    cl::init(0));
+
+static cl::opt<unsigned> FactBudget("lfcpa-fact-budget",
+    cl::desc("Stop the analysis once the interned facts take up about this many megabytes, and answer queries with the unification pre-pass instead (0 means no limit)"),
+    cl::init(0));
+
+static cl::opt<unsigned> FunctionBudget("lfcpa-function-budget",
+    cl::desc("Once a function has taken this many iterations of the worklist over all of its contexts, analyse the calls to it in one context for each call site (0 means no limit)"),
+    cl::init(0));
 
 typedef SmallVector<APInt, 8> IndexList;
 
-std::set<PointsToNode *> LivenessPointsTo::getPointsToSet(const Value *V, bool &AllowMustAlias) {
+PointsToNodeSet LivenessPointsTo::getPointsToSet(const Value *V, bool &AllowMustAlias) {
     if (const Instruction *I = dyn_cast<Instruction>(V)) {
+        // The facts of an analysis that was stopped are missing pairs.
+        if (incomplete)
+            return PointsToNodeSet();
         PointsToNode *N = factory.getNode(I);
         // If N is a summary node, the data may include pointees of fields.
         if (N->isAlwaysSummaryNode() || !N->isFieldSensitive())
@@ -32,34 +87,41 @@ std::set<PointsToNode *> LivenessPointsTo::getPointsToSet(const Value *V, bool &
         const Function *F = BB->getParent();
         ProcedurePointsTo *P = data.getAtFunction(F);
         for (auto p : *P) {
-            if (std::get<0>(p) == CallString::empty()) {
-                auto P = std::get<1>(p)->find(I);
-                if (P == std::get<1>(p)->end())
-                    return std::set<PointsToNode *>();
-                PointsToRelation *R = P->second.second;
-                std::set<PointsToNode *> s;
+            if (std::get<0>(p).isEmpty()) {
+                const PointsToRelation *R = data.getFactsAt(std::get<1>(p), I).second;
+                PointsToNodeSet s;
                 for (auto Pointee = R->pointee_begin(N), E = R->pointee_end(N); Pointee != E; ++Pointee)
                     s.insert(*Pointee);
                 return s;
             }
         }
+        // A function that isn't a root is only analysed in the contexts that
+        // reach it, so V can point to what it points to in any of them. If it
+        // wasn't reached, the set is empty.
+        PointsToNodeSet s;
+        for (auto p : *P) {
+            const PointsToRelation *R = data.getFactsAt(std::get<1>(p), I).second;
+            for (auto Pointee = R->pointee_begin(N), E = R->pointee_end(N); Pointee != E; ++Pointee)
+                s.insert(*Pointee);
+        }
+        return s;
     }
     else if (const GlobalVariable *G = dyn_cast<GlobalVariable>(V)) {
-        std::set<PointsToNode *> s;
+        PointsToNodeSet s;
         s.insert(factory.getGlobalNode(G));
         return s;
     }
     else if (const GEPOperator *GEP = dyn_cast<GEPOperator>(V)) {
         if (GEP->hasAllConstantIndices()) {
             if (const GlobalVariable *Base = dyn_cast<GlobalVariable>(GEP->getPointerOperand())) {
-                std::set<PointsToNode *> s;
+                PointsToNodeSet s;
                 PointsToNode *Global = factory.getGlobalNode(Base);
                 s.insert(factory.getIndexedNode(Global, GEP));
                 return s;
             }
         }
         else {
-            std::set<PointsToNode *> s;
+            PointsToNodeSet s;
             // We represent non-constant GEPs by the node corresponding to the
             // pointer operand. Note that we cannot use this result as the basis
             // of a PartialAlias or MustAlias result.
@@ -71,26 +133,31 @@ std::set<PointsToNode *> LivenessPointsTo::getPointsToSet(const Value *V, bool &
 
     // If we can't determine what V can point to, return the empty set (i.e.
     // "don't know").
-    return std::set<PointsToNode *>();
+    return PointsToNodeSet();
+}
+
+// Returns false if the unification pre-pass found that A and B can't point to
+// the same object. If it wasn't run, it returns true.
+bool LivenessPointsTo::mayAliasByUnification(const Value *A, const Value *B) const {
+    return unification.mayAlias(A, B);
 }
 
-std::pair<PointsToNode *, PointsToNode *> makePointsToPair(PointsToNode *Pointer, PointsToNode *Pointee) {
+std::pair<PointsToNode *, PointsToNode *> makePointsToPair(PointsToNodeFactory &Factory, PointsToNode *Pointer, PointsToNode *Pointee) {
     if (Pointer->pointeesAreSummaryNodes() && !Pointee->isAlwaysSummaryNode()) {
         // If we turn the pointee into a summary node, this may affect what
-        // stores to the pointee do. However, these will be added to the
-        // worklist again.
-        createdSummaryNode = true;
-        Pointee->markAsSummaryNode();
+        // stores to the pointee do. However, the factory records it, so that
+        // these will be added to the worklist again.
+        Factory.markAsSummaryNode(Pointee);
     }
 
     return {Pointer, Pointee};
 }
 
-bool isLive(PointsToNode *N, LivenessSet &L) {
+bool isLive(PointsToNode *N, const LivenessSet &L) {
     return N->singlePointee() || !N->hasPointerType() || L.find(N) != L.end();
 }
 
-bool isDescendantLive(PointsToNode *N, LivenessSet &L) {
+bool isDescendantLive(PointsToNode *N, const LivenessSet &L) {
     if (isLive(N, L))
         return true;
 
@@ -102,7 +169,7 @@ bool isDescendantLive(PointsToNode *N, LivenessSet &L) {
     return false;
 }
 
-void makeDescendantsAndPointeesLive(LivenessSet &Lin, PointsToNode *N, PointsToRelation &Ain) {
+void makeDescendantsAndPointeesLive(LivenessSet &Lin, PointsToNode *N, const PointsToRelation &Ain) {
     Lin.insert(N);
     for (auto P = Ain.pointee_begin(N), E = Ain.pointee_end(N); P != E; ++P)
         Lin.insert(*P);
@@ -170,7 +237,7 @@ void killDescendants(LivenessSet &Lin, PointsToNode *N) {
         Lin.erase(C);
 }
 
-void subtractKillStoreInst(const CallString &CS, LivenessSet &Lin, PointsToNode *Ptr, PointsToRelation &Ain) {
+void subtractKillStoreInst(const CallString &CS, LivenessSet &Lin, PointsToNode *Ptr, const PointsToRelation &Ain) {
     if (!Ptr->isAggregate()) {
         bool strongUpdate = true;
         PointsToNode *PointedTo = nullptr;
@@ -213,7 +280,7 @@ void subtractKillStoreInst(const CallString &CS, LivenessSet &Lin, PointsToNode
 void LivenessPointsTo::subtractKill(const CallString &CS,
                                     LivenessSet &Lin,
                                     const Instruction *I,
-                                    PointsToRelation &Ain) {
+                                    const PointsToRelation &Ain) {
     assert(!isa<CallInst>(I) && "CallInsts are analysed using a different part of the code.");
     PointsToNode *N = factory.getNode(I);
 
@@ -265,15 +332,15 @@ void makeDescendantsLive(LivenessSet &Lin, PointsToNode *N) {
         makeDescendantsLive(Lin, D);
 }
 
-void makeDescendantsPointTo(PointsToRelation &Aout, PointsToNode *N, PointsToNode *Pointee, LivenessSet &Lout) {
+void makeDescendantsPointTo(PointsToNodeFactory &Factory, PointsToRelation &Aout, PointsToNode *N, PointsToNode *Pointee, const LivenessSet &Lout) {
     if (Lout.find(N) != Lout.end())
-        Aout.insert(makePointsToPair(N, Pointee));
+        Aout.insert(makePointsToPair(Factory, N, Pointee));
 
     for (PointsToNode *D : N->children)
-        makeDescendantsPointTo(Aout, D, Pointee, Lout);
+        makeDescendantsPointTo(Factory, Aout, D, Pointee, Lout);
 }
 
-bool isPointeeLive(PointsToNode *N, LivenessSet &Lout, PointsToRelation &Ain) {
+bool isPointeeLive(PointsToNode *N, const LivenessSet &Lout, const PointsToRelation &Ain) {
     for (auto P = Ain.pointee_begin(N), E = Ain.pointee_end(N); P != E; ++P)
         if (isLive(*P, Lout))
             return true;
@@ -281,7 +348,7 @@ bool isPointeeLive(PointsToNode *N, LivenessSet &Lout, PointsToRelation &Ain) {
     return false;
 }
 
-bool isPointeeOfDescendantLive(PointsToNode *N, LivenessSet &Lout, PointsToRelation &Ain) {
+bool isPointeeOfDescendantLive(PointsToNode *N, const LivenessSet &Lout, const PointsToRelation &Ain) {
     if (isPointeeLive(N, Lout, Ain))
         return true;
 
@@ -300,7 +367,7 @@ PointsToNode *findDescendantExact(PointsToNode *N, IndexList &L) {
     return nullptr;
 }
 
-void makeChildren(PointsToNode *NoChildren, PointsToNode *SomeChildren) {
+void makeChildren(PointsToNodeFactory &Factory, PointsToNode *NoChildren, PointsToNode *SomeChildren) {
     assert(NoChildren->isFieldSensitive());
     assert(SomeChildren->isFieldSensitive());
     for (auto D : getDescendants(SomeChildren)) {
@@ -314,14 +381,13 @@ void makeChildren(PointsToNode *NoChildren, PointsToNode *SomeChildren) {
             assert(T->isPointerTy());
             Pointee = findDescendantExact(NoChildren->getSinglePointee(), D.first);
             if (Pointee == nullptr)
-                Pointee = new GEPPointsToNode(NoChildren->getSinglePointee(), T->getPointerElementType(), D.first, nullptr);
+                Pointee = Factory.makeChildNode(NoChildren->getSinglePointee(), T->getPointerElementType(), D.first, nullptr);
         }
-        // The constructor adds the node to the list of children.
-        new GEPPointsToNode(NoChildren, N->NodeType->getPointerElementType(), D.first, Pointee);
+        Factory.makeChildNode(NoChildren, N->NodeType->getPointerElementType(), D.first, Pointee);
     }
 }
 
-void makeChildrenPointer(PointsToNode *NoChildren, PointsToNode *SomeChildren) {
+void makeChildrenPointer(PointsToNodeFactory &Factory, PointsToNode *NoChildren, PointsToNode *SomeChildren) {
     assert(NoChildren->isFieldSensitive());
     assert(SomeChildren->isFieldSensitive());
     for (auto D : getDescendants(SomeChildren)) {
@@ -334,16 +400,15 @@ void makeChildrenPointer(PointsToNode *NoChildren, PointsToNode *SomeChildren) {
         if (NoChildren->singlePointee()) {
             Pointee = findDescendantExact(NoChildren->getSinglePointee(), D.first);
             if (Pointee == nullptr)
-                Pointee = new GEPPointsToNode(NoChildren->getSinglePointee(), T, D.first, nullptr);
+                Pointee = Factory.makeChildNode(NoChildren->getSinglePointee(), T, D.first, nullptr);
         }
-        // The constructor adds the node to the list of children.
         // I don't like the const cast here, but LLVM before version 3.8.0
         // doesn't mark getPointerTo as const, so its needed.
-        new GEPPointsToNode(NoChildren, const_cast<Type*>(T)->getPointerTo(), D.first, Pointee);
+        Factory.makeChildNode(NoChildren, const_cast<Type*>(T)->getPointerTo(), D.first, Pointee);
     }
 }
 
-void unionRefLoadInst(LivenessSet& Lin, PointsToNode *Ptr, PointsToNode *Load, LivenessSet &Lout, PointsToRelation &Ain) {
+void unionRefLoadInst(PointsToNodeFactory &Factory, LivenessSet& Lin, PointsToNode *Ptr, PointsToNode *Load, const LivenessSet &Lout, const PointsToRelation &Ain) {
     if (!Ptr->isAggregate() && isDescendantLive(Load, Lout)) {
         Lin.insert(Ptr);
         for (auto P = Ain.pointee_begin(Ptr), E = Ain.pointee_end(Ptr); P != E; ++P)
@@ -357,7 +422,7 @@ void unionRefLoadInst(LivenessSet& Lin, PointsToNode *Ptr, PointsToNode *Load, L
                 // node), it is because no children have been created for it. We
                 // create them here so that pointer information is correctly
                 // tracked.
-                makeChildren(Load, Ptr);
+                makeChildren(Factory, Load, Ptr);
                 assert(Load->isAggregate());
             }
             else {
@@ -376,7 +441,7 @@ void unionRefLoadInst(LivenessSet& Lin, PointsToNode *Ptr, PointsToNode *Load, L
     }
 }
 
-void unionRefStoreInst(LivenessSet &Lin, PointsToNode *Ptr, PointsToNode *Value, LivenessSet &Lout, PointsToRelation &Ain) {
+void unionRefStoreInst(PointsToNodeFactory &Factory, LivenessSet &Lin, PointsToNode *Ptr, PointsToNode *Value, const LivenessSet &Lout, const PointsToRelation &Ain) {
     if (!Ptr->isAggregate() && !Value->isAggregate()) {
         Lin.insert(Ptr);
 
@@ -393,7 +458,7 @@ void unionRefStoreInst(LivenessSet &Lin, PointsToNode *Ptr, PointsToNode *Value,
                 // node), it is because no children have been created for it. We
                 // create them here so that pointer information is correctly
                 // tracked.
-                makeChildrenPointer(Ptr, Value);
+                makeChildrenPointer(Factory, Ptr, Value);
                 assert(Ptr->isAggregate());
             }
         }
@@ -407,7 +472,7 @@ void unionRefStoreInst(LivenessSet &Lin, PointsToNode *Ptr, PointsToNode *Value,
                 // node), it is because no children have been created for it. We
                 // create them here so that pointer information is correctly
                 // tracked.
-                makeChildren(Value, Ptr);
+                makeChildren(Factory, Value, Ptr);
                 assert(Value->isAggregate());
             }
             else {
@@ -428,21 +493,21 @@ void unionRefStoreInst(LivenessSet &Lin, PointsToNode *Ptr, PointsToNode *Value,
 
 void LivenessPointsTo::unionRef(LivenessSet& Lin,
                                 const Instruction *I,
-                                LivenessSet& Lout,
-                                PointsToRelation& Ain) {
+                                const LivenessSet &Lout,
+                                const PointsToRelation &Ain) {
     if (const LoadInst *LI = dyn_cast<LoadInst>(I)) {
         // We only consider the pointer and the possible values in memory to be
         // ref'd if the load is live.
         const Value *Ptr = LI->getPointerOperand();
         PointsToNode *PtrNode = factory.getNode(Ptr);
         PointsToNode *N = factory.getNode(I);
-        unionRefLoadInst(Lin, PtrNode, N, Lout, Ain);
+        unionRefLoadInst(factory, Lin, PtrNode, N, Lout, Ain);
     }
     else if (const StoreInst *SI = dyn_cast<StoreInst>(I)) {
         const Value *Ptr = SI->getPointerOperand();
         PointsToNode *PtrNode = factory.getNode(Ptr);
         PointsToNode *Value = factory.getNode(SI->getValueOperand());
-        unionRefStoreInst(Lin, PtrNode, Value, Lout, Ain);
+        unionRefStoreInst(factory, Lin, PtrNode, Value, Lout, Ain);
     }
     else if (isa<PHINode>(I) || isa<SelectInst>(I)) {
         // We only consider the operands of a PHI node or select instruction to
@@ -501,7 +566,7 @@ void unionDescendants(SmallVector<std::pair<IndexList, PointsToNode *>, 8> &S, c
     }
 }
 
-void unionPointeesWithDescendants(SmallVector<std::pair<IndexList, PointsToNode *>, 8> &Pointees, PointsToRelation &Ain, const IndexList &L, PointsToNode *N) {
+void unionPointeesWithDescendants(SmallVector<std::pair<IndexList, PointsToNode *>, 8> &Pointees, const PointsToRelation &Ain, const IndexList &L, PointsToNode *N) {
     if (isa<UnknownPointsToNode>(N)) {
         // Assume here that ?-->?.
         Pointees.push_back({L, N});
@@ -520,21 +585,21 @@ void unionPointeesWithDescendants(SmallVector<std::pair<IndexList, PointsToNode
     }
 }
 
-void unionRelationApplicationWithDescendants(SmallVector<std::pair<IndexList, PointsToNode *>, 8> &Pointees, PointsToRelation &Ain, const SmallVector<std::pair<IndexList, PointsToNode *>, 8> &S) {
+void unionRelationApplicationWithDescendants(SmallVector<std::pair<IndexList, PointsToNode *>, 8> &Pointees, const PointsToRelation &Ain, const SmallVector<std::pair<IndexList, PointsToNode *>, 8> &S) {
     for (auto P : S)
         unionPointeesWithDescendants(Pointees, Ain, P.first, P.second);
 }
 
-void insertNewPairsLoadInst(PointsToRelation &Aout, PointsToNode *Load, PointsToNode *Ptr, PointsToNode *Unknown, PointsToRelation &Ain, LivenessSet &Lout) {
+void insertNewPairsLoadInst(PointsToNodeFactory &Factory, PointsToRelation &Aout, PointsToNode *Load, PointsToNode *Ptr, PointsToNode *Unknown, const PointsToRelation &Ain, const LivenessSet &Lout) {
     if (!Load->isAggregate()) {
         if (!isLive(Load, Lout))
             return;
 
-        std::set<PointsToNode *> t;
+        PointsToRelation::NodeSet t;
         for (auto P = Ain.pointee_begin(Ptr), E = Ain.pointee_end(Ptr); P != E; ++P)
             t.insert(*P);
         for (auto P = Ain.restriction_begin(t), E = Ain.restriction_end(t); P != E; ++P)
-            Aout.insert(makePointsToPair(Load, P->second));
+            Aout.insert(makePointsToPair(Factory, Load, P->second));
     }
     else {
         SmallVector<std::pair<IndexList, PointsToNode *>, 8> p, pointees;
@@ -546,7 +611,7 @@ void insertNewPairsLoadInst(PointsToRelation &Aout, PointsToNode *Load, PointsTo
                 for (auto P : p) {
                     switch (matchIndexLists(D.first, P.first)) {
                         case Exact:
-                            Aout.insert(makePointsToPair(D.second, P.second));
+                            Aout.insert(makePointsToPair(Factory, D.second, P.second));
                             break;
                         case Shorter:
                             // If D.second is an aggregate points to pairs will
@@ -563,12 +628,12 @@ void insertNewPairsLoadInst(PointsToRelation &Aout, PointsToNode *Load, PointsTo
     }
 }
 
-void insertNewPairsStoreInst(PointsToRelation &Aout, PointsToNode *Ptr, PointsToNode *Value, PointsToNode *Unknown, PointsToRelation &Ain, LivenessSet &Lout) {
+void insertNewPairsStoreInst(PointsToNodeFactory &Factory, PointsToRelation &Aout, PointsToNode *Ptr, PointsToNode *Value, PointsToNode *Unknown, const PointsToRelation &Ain, const LivenessSet &Lout) {
     if (!Ptr->isAggregate() && !Value->isAggregate()) {
         for (auto P = Ain.pointee_begin(Ptr), PE = Ain.pointee_end(Ptr); P != PE; ++P) {
             if (Lout.find(*P) != Lout.end())
                 for (auto Q = Ain.pointee_begin(Value), QE = Ain.pointee_end(Value); Q != QE; ++Q)
-                    Aout.insert(makePointsToPair(*P, *Q));
+                    Aout.insert(makePointsToPair(Factory, *P, *Q));
         }
     }
     else {
@@ -581,7 +646,7 @@ void insertNewPairsStoreInst(PointsToRelation &Aout, PointsToNode *Ptr, PointsTo
                 for (auto Q : valuePointees) {
                     switch (matchIndexLists(P.first, Q.first)) {
                         case Exact:
-                            Aout.insert(makePointsToPair(P.second, Q.second));
+                            Aout.insert(makePointsToPair(Factory, P.second, Q.second));
                             break;
                         case Shorter:
                             (void)Unknown;
@@ -596,13 +661,13 @@ void insertNewPairsStoreInst(PointsToRelation &Aout, PointsToNode *Ptr, PointsTo
     }
 }
 
-void insertNewPairsAssignment(PointsToRelation &Aout, PointsToNode *L, PointsToNode *R, PointsToNode *Unknown, PointsToRelation &Ain, LivenessSet &Lout) {
+void insertNewPairsAssignment(PointsToNodeFactory &Factory, PointsToRelation &Aout, PointsToNode *L, PointsToNode *R, PointsToNode *Unknown, const PointsToRelation &Ain, const LivenessSet &Lout) {
     if (!L->isAggregate() && !R->isAggregate()) {
         if (Lout.find(L) == Lout.end())
             return;
 
         for (auto P = Ain.pointee_begin(R), E = Ain.pointee_end(R); P != E; ++P)
-            Aout.insert(makePointsToPair(L, *P));
+            Aout.insert(makePointsToPair(Factory, L, *P));
     }
     else {
         SmallVector<std::pair<IndexList, PointsToNode *>, 8> pointees;
@@ -613,7 +678,7 @@ void insertNewPairsAssignment(PointsToRelation &Aout, PointsToNode *L, PointsToN
                 for (auto P : pointees) {
                     switch (matchIndexLists(D.first, P.first)) {
                         case Exact:
-                            Aout.insert(makePointsToPair(D.second, P.second));
+                            Aout.insert(makePointsToPair(Factory, D.second, P.second));
                             break;
                         case Shorter:
                             (void)Unknown;
@@ -628,27 +693,27 @@ void insertNewPairsAssignment(PointsToRelation &Aout, PointsToNode *L, PointsToN
     }
 }
 
-void LivenessPointsTo::insertNewPairs(PointsToRelation &Aout, const Instruction *I, PointsToRelation &Ain, LivenessSet &Lout) {
+void LivenessPointsTo::insertNewPairs(PointsToRelation &Aout, const Instruction *I, const PointsToRelation &Ain, const LivenessSet &Lout) {
     PointsToNode *Unknown = factory.getUnknown();
     if (const LoadInst *LI = dyn_cast<LoadInst>(I)) {
         PointsToNode *Load = factory.getNode(LI);
         PointsToNode *Pointer = factory.getNode(LI->getPointerOperand());
-        insertNewPairsLoadInst(Aout, Load, Pointer, Unknown, Ain, Lout);
+        insertNewPairsLoadInst(factory, Aout, Load, Pointer, Unknown, Ain, Lout);
     }
     else if (const StoreInst *SI = dyn_cast<StoreInst>(I)) {
         PointsToNode *Ptr = factory.getNode(SI->getPointerOperand());
         PointsToNode *Value = factory.getNode(SI->getValueOperand());
-        insertNewPairsStoreInst(Aout, Ptr, Value, Unknown, Ain, Lout);
+        insertNewPairsStoreInst(factory, Aout, Ptr, Value, Unknown, Ain, Lout);
     }
     else if (const SelectInst *SI = dyn_cast<SelectInst>(I)) {
         PointsToNode *Select = factory.getNode(SI);
-        insertNewPairsAssignment(Aout, Select, factory.getNode(SI->getFalseValue()), Unknown, Ain, Lout);
-        insertNewPairsAssignment(Aout, Select, factory.getNode(SI->getTrueValue()), Unknown, Ain, Lout);
+        insertNewPairsAssignment(factory, Aout, Select, factory.getNode(SI->getFalseValue()), Unknown, Ain, Lout);
+        insertNewPairsAssignment(factory, Aout, Select, factory.getNode(SI->getTrueValue()), Unknown, Ain, Lout);
     }
     else if (const PHINode *Phi = dyn_cast<PHINode>(I)) {
         PointsToNode *N = factory.getNode(Phi);
         for (auto &V : Phi->incoming_values())
-            insertNewPairsAssignment(Aout, N, factory.getNode(V), Unknown, Ain, Lout);
+            insertNewPairsAssignment(factory, Aout, N, factory.getNode(V), Unknown, Ain, Lout);
     }
     else if (const GEPOperator *GEP = dyn_cast<GEPOperator>(I)) {
         PointsToNode *N = factory.getNode(GEP);
@@ -682,11 +747,11 @@ void LivenessPointsTo::insertNewPairs(PointsToRelation &Aout, const Instruction
     }
     else if (const AllocaInst *AI = dyn_cast<AllocaInst>(I)) {
         PointsToNode *Alloca = factory.getNoAliasNode(AI);
-        makeDescendantsPointTo(Aout, Alloca, Unknown, Lout);
+        makeDescendantsPointTo(factory, Aout, Alloca, Unknown, Lout);
     }
     else if (const BitCastInst *CI = dyn_cast<BitCastInst>(I)) {
         if (!canHandleBitcast(CI))
-            makeDescendantsPointTo(Aout, factory.getNode(CI), Unknown, Lout);
+            makeDescendantsPointTo(factory, Aout, factory.getNode(CI), Unknown, Lout);
     }
 }
 
@@ -694,38 +759,42 @@ ProcedurePointsTo *LivenessPointsTo::getPointsTo(Function &F) const {
     return data.getAtFunction(&F);
 }
 
-bool hasPointee(PointsToRelation &S, PointsToNode *N) {
+std::pair<const LivenessSet *, const PointsToRelation *> LivenessPointsTo::getFactsAt(const IntraproceduralPointsTo *Facts, const Instruction *I) {
+    return data.getFactsAt(Facts, I);
+}
+
+bool hasPointee(const PointsToRelation &S, PointsToNode *N) {
     return S.pointee_begin(N) != S.pointee_end(N);
 }
 
-void LivenessPointsTo::computeLout(const Instruction *I, LivenessSet& Lout, IntraproceduralPointsTo &Result) {
+void LivenessPointsTo::computeLout(const FlowGraph &G, unsigned Node, const LivenessSet *&Lout, IntraproceduralPointsTo &Result) {
+    const Instruction *I = G.getInstruction(Node);
+    ArrayRef<unsigned> Succs = G.succs(Node);
     if (isa<ReturnInst>(I)) {
         // After a return instruction, nothing is live.
     }
-    else if (const TerminatorInst *TI = dyn_cast<TerminatorInst>(I)) {
-        // If this instruction is a terminator, it may have multiple
-        // successors.
-        Lout.clear();
-        for (unsigned i = 0; i < TI->getNumSuccessors(); i++) {
-            Instruction *Succ = TI->getSuccessor(i)->begin();
-            auto succ_result = Result.find(Succ);
-            assert(succ_result != Result.end());
-            auto succ_lin = succ_result->second.first;
-            Lout.insertAll(*succ_lin);
+    else if (Succs.size() == 1) {
+        // If this instruction has exactly one successor, lout is the same set
+        // as the successor's lin.
+        auto succ_result = Result.find(G.getInstruction(Succs[0]));
+        assert(succ_result != Result.end());
+        auto succ_lin = succ_result->second.first;
+        if (succ_lin != Lout) {
+            assert(succ_lin->isSubset(*Lout));
+            Lout = succ_lin;
         }
     }
     else {
-        // If this instruction is not a terminator, it has exactly one
-        // successor -- the next instruction in the function.
-        const Instruction *Succ = getNextInstruction(I);
-        auto succ_result = Result.find(Succ);
-        assert(succ_result != Result.end());
-        auto succ_lin = succ_result->second.first;
-        if (*succ_lin != Lout) {
-            assert(succ_lin->isSubset(Lout));
-            Lout.clear();
-            Lout.insertAll(*succ_lin);
+        // Otherwise, for example if the instruction is a terminator, lout is
+        // the union of the successors' lins.
+        LivenessSet n;
+        for (unsigned Succ : Succs) {
+            auto succ_result = Result.find(G.getInstruction(Succ));
+            assert(succ_result != Result.end());
+            auto succ_lin = succ_result->second.first;
+            n.insertAll(*succ_lin);
         }
+        Lout = facts.intern(n);
     }
 }
 
@@ -736,11 +805,12 @@ bool LivenessPointsTo::isArgument(const Function *F, const PointsToNode *N) {
 
     return false;
 }
-bool LivenessPointsTo::computeAin(const Instruction *I, const Function *F, PointsToRelation &Ain, LivenessSet &Lin, IntraproceduralPointsTo *Result, bool InsertAtFirstInstruction) {
+bool LivenessPointsTo::computeAin(const FlowGraph &G, unsigned Node, const Function *F, const PointsToRelation *&Ain, const LivenessSet &Lin, IntraproceduralPointsTo *Result, bool InsertAtFirstInstruction) {
     // Compute ain for the current instruction.
+    const Instruction *I = G.getInstruction(Node);
     PointsToRelation s;
     if (I == &*inst_begin(F)) {
-        s = Ain;
+        s = *Ain;
         if (InsertAtFirstInstruction) {
             // If this is the first instruction of the function, then apart from
             // the data in entry, we don't know what anything points to. ain
@@ -764,39 +834,24 @@ bool LivenessPointsTo::computeAin(const Instruction *I, const Function *F, Point
     else {
         // If this is not the first instruction, then the points to
         // information from the predecessors can be propagated forwards.
-        const BasicBlock *BB = I->getParent();
-        const Instruction *FirstInBB = BB->begin();
-        if (FirstInBB == I) {
-            for (const_pred_iterator PI = pred_begin(BB), E = pred_end(BB);
-                 PI != E;
-                 ++PI) {
-                const BasicBlock *PredBB = *PI;
-                const Instruction *Pred = --(PredBB->end());
-                auto pred_result = Result->find(Pred);
-                assert(pred_result != Result->end());
-                PointsToRelation *PredAout = pred_result->second.second;
-                s.unionRelationRestriction(*PredAout, Lin);
-            }
-        }
-        else {
-            const Instruction *Pred = getPreviousInstruction(I);
-            auto pred_result = Result->find(Pred);
+        for (unsigned Pred : G.preds(Node)) {
+            auto pred_result = Result->find(G.getInstruction(Pred));
             assert(pred_result != Result->end());
-            PointsToRelation *PredAout = pred_result->second.second;
+            const PointsToRelation *PredAout = pred_result->second.second;
             s.unionRelationRestriction(*PredAout, Lin);
         }
     }
-    if (s != Ain) {
-        assert(s.isSubset(Ain));
-        Ain.clear();
-        Ain.insertAll(s);
+    const PointsToRelation *Interned = facts.intern(s);
+    if (Interned != Ain) {
+        assert(s.isSubset(*Ain));
+        Ain = Interned;
         return true;
     }
 
     return false;
 }
 
-bool LivenessPointsTo::getCalledFunctions(SmallVector<const Function *, 8> &Result, const CallInst *CI, PointsToRelation &Ain) {
+bool LivenessPointsTo::getCalledFunctions(SmallVector<const Function *, 8> &Result, const CallInst *CI, const PointsToRelation &Ain) {
     if (CI->getCalledFunction() != nullptr) {
         Result.push_back(CI->getCalledFunction());
         return false;
@@ -805,13 +860,13 @@ bool LivenessPointsTo::getCalledFunctions(SmallVector<const Function *, 8> &Resu
     // Use Ain to work out what the called value can point to.
     PointsToNode *CalledValue = factory.getNode(CI->getCalledValue());
     for (auto I = Ain.pointee_begin(CalledValue), E = Ain.pointee_end(CalledValue); I != E; ++I) {
-        if (isa<UnknownPointsToNode>(*I))
-            return true;
-
-        const Function *F = (*I)->getFunction();
+        const Function *F = isa<UnknownPointsToNode>(*I) ? nullptr : (*I)->getFunction();
         if (F == nullptr) {
-            // Couldn't find a function corresponding to *I.
-            return true;
+            // Couldn't find a function corresponding to *I, but the
+            // unification pre-pass may still know every function that the
+            // call can reach.
+            Result.clear();
+            return !unification.getCallees(CI, Result);
         }
         else
             Result.push_back(F);
@@ -820,7 +875,7 @@ bool LivenessPointsTo::getCalledFunctions(SmallVector<const Function *, 8> &Resu
     return false;
 }
 
-void LivenessPointsTo::addLinCalledDeclaration(LivenessSet &N, const CallString &CS, const CallInst *CI, LivenessSet &Lout) {
+void LivenessPointsTo::addLinCalledDeclaration(LivenessSet &N, const CallString &CS, const CallInst *CI, const LivenessSet &Lout) {
     // We reach this point if we have a declaration. Just assume the worst case
     // -- the function may invalidate or use anything that it has access to.
     LivenessSet n = Lout;
@@ -837,10 +892,10 @@ void LivenessPointsTo::addLinCalledDeclaration(LivenessSet &N, const CallString
     N.insertAll(n);
 }
 
-void LivenessPointsTo::addLinAnalysableCalledFunction(LivenessSet &N, const Function *Called, const CallString &CS, const CallInst *CI, LivenessSet &Lout, LivenessSet &Relevant) {
-    CallString newCS = CS.addCallSite(CI);
+void LivenessPointsTo::addLinAnalysableCalledFunction(LivenessSet &N, const Function *Called, const CallString &CS, const CallInst *CI, const PointsToRelation &Ain, const LivenessSet &Lout, LivenessSet &Relevant) {
+    CallString newCS = getCallString(CS, CI, Called);
     // The set of values that are returned from the function.
-    std::set<PointsToNode *> returnValues = getReturnValues(Called);
+    PointsToNodeSet returnValues = getReturnValues(Called);
 
     std::pair<LivenessSet, PointsToRelation> calledFunctionResult = getCalledFunctionResult(newCS, Called);
     auto calledFunctionLin = calledFunctionResult.first;
@@ -854,12 +909,21 @@ void LivenessPointsTo::addLinAnalysableCalledFunction(LivenessSet &N, const Func
             n.insert(*I);
         }
     }
+    if (Summaries) {
+        // The nodes that the callee can't see were left out of its boundary
+        // information, so they stay live across the call.
+        SmallPtrSet<PointsToNode *, 32> Observable;
+        findObservableNodesAtCall(Called, CI, Ain, Lout, Observable);
+        for (PointsToNode *L : Lout)
+            if (Observable.count(L) == 0)
+                n.insert(L);
+    }
 
     // TODO: This isn't very efficient...
     N.insertAll(n);
 }
 
-LivenessSet LivenessPointsTo::findRelevantNodes(const CallInst *CI, LivenessSet &Lout) {
+LivenessSet LivenessPointsTo::findRelevantNodes(const CallInst *CI, const LivenessSet &Lout) {
     LivenessSet reachable = Lout;
 
     for (Value *V : CI->arg_operands()) {
@@ -871,7 +935,7 @@ LivenessSet LivenessPointsTo::findRelevantNodes(const CallInst *CI, LivenessSet
 }
 
 
-bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, PointsToRelation &Ain, LivenessSet &Lin, LivenessSet &Lout) {
+bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, const PointsToRelation &Ain, const LivenessSet *&Lin, const LivenessSet &Lout) {
     if (const CallInst *CI = dyn_cast<CallInst>(I)) {
         PointsToNode *CINode = factory.getNode(CI);
 
@@ -883,14 +947,14 @@ bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, Po
         if (pointsToUnknown) {
             // The function is undefined -- just insert what's already there for
             // monotonicity
-            n = Lin;
+            n = *Lin;
         }
         else {
             for (const Function *Called : CalledFunctions) {
                 if (Called->isDeclaration())
                     addLinCalledDeclaration(n, CS, CI, Lout);
                 else
-                    addLinAnalysableCalledFunction(n, Called, CS, CI, Lout, relevant);
+                    addLinAnalysableCalledFunction(n, Called, CS, CI, Ain, Lout, relevant);
             }
         }
 
@@ -908,14 +972,20 @@ bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, Po
         // The function is live.
         PointsToNode *CalledValue = factory.getNode(CI->getCalledValue());
         makeDescendantsLive(n, CalledValue);
+        // The nodes that go around the callee shrink as the callee comes to
+        // see more of the caller's objects, so keep what was here before. The
+        // results of a callee can also shrink when its calls are merged, until
+        // the merged context catches up with the one that was used before.
+        if (Summaries || callsMergedFunction(CalledFunctions))
+            n.insertAll(*Lin);
 
         // If the two sets are the same, then no changes need to be made to lin,
         // so don't do anything here. Otherwise, we need to update lin and add
         // the predecessors of the current instruction to the worklist.
-        if (n != Lin) {
-            assert(n.isSubset(Lin));
-            Lin.clear();
-            Lin.insertAll(n);
+        const LivenessSet *Interned = facts.intern(n);
+        if (Interned != Lin) {
+            assert(n.isSubset(*Lin));
+            Lin = Interned;
             return true;
         }
         else
@@ -930,10 +1000,10 @@ bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, Po
         // If the two sets are the same, then no changes need to be made to lin,
         // so don't do anything here. Otherwise, we need to update lin and add
         // the predecessors of the current instruction to the worklist.
-        if (n != Lin) {
-            assert(n.isSubset(Lin));
-            Lin.clear();
-            Lin.insertAll(n);
+        const LivenessSet *Interned = facts.intern(n);
+        if (Interned != Lin) {
+            assert(n.isSubset(*Lin));
+            Lin = Interned;
             return true;
         }
         else
@@ -941,15 +1011,15 @@ bool LivenessPointsTo::computeLin(const CallString &CS, const Instruction *I, Po
     }
 }
 
-void LivenessPointsTo::addAoutCalledDeclaration(PointsToRelation &S, const CallInst *CI, PointsToRelation &Ain, LivenessSet &Lout) {
+void LivenessPointsTo::addAoutCalledDeclaration(PointsToRelation &S, const CallInst *CI, const PointsToRelation &Ain, const LivenessSet &Lout) {
     PointsToNode *CINode = factory.getNode(CI);
 
     // Anything that can be modified by the function (including the return value
     // unless it has the noalias attribute) anything that is reachable, and
     // something else; anything else points to the same thing that it does in
     // Ain.
-    std::set<PointsToNode *> killable = getKillableDeclaration(CI, Ain);
-    std::set<PointsToNode *> addressable = killable;
+    PointsToNodeSet killable = getKillableDeclaration(CI, Ain);
+    PointsToNodeSet addressable = killable;
     PointsToRelation s;
     if (!CI->paramHasAttr(0, Attribute::NoAlias))
         killable.insert(CINode);
@@ -977,10 +1047,10 @@ void LivenessPointsTo::addAoutCalledDeclaration(PointsToRelation &S, const CallI
     S.insertAll(s);
 }
 
-void LivenessPointsTo::addAoutAnalysableCalledFunction(PointsToRelation &S, const Function *Called, const CallString &CS, const CallInst *CI, PointsToRelation &Ain, LivenessSet &Lout) {
-    CallString newCS = CS.addCallSite(CI);
+void LivenessPointsTo::addAoutAnalysableCalledFunction(PointsToRelation &S, const Function *Called, const CallString &CS, const CallInst *CI, const PointsToRelation &Ain, const LivenessSet &Lout) {
+    CallString newCS = getCallString(CS, CI, Called);
     // The set of values that are returned from the function.
-    std::set<PointsToNode *> returnValues = getReturnValues(Called);
+    PointsToNodeSet returnValues = getReturnValues(Called);
 
     std::pair<LivenessSet, PointsToRelation> calledFunctionResult = getCalledFunctionResult(newCS, Called);
     auto calledFunctionLin = calledFunctionResult.first;
@@ -995,6 +1065,15 @@ void LivenessPointsTo::addAoutAnalysableCalledFunction(PointsToRelation &S, cons
             s.insert(*I);
         }
     }
+    if (Summaries) {
+        // The pairs of the pointers that the callee can't see were left out of
+        // its boundary information, so they are unchanged by the call.
+        SmallPtrSet<PointsToNode *, 32> Observable;
+        findObservableNodesAtCall(Called, CI, Ain, Lout, Observable);
+        for (auto P = Ain.restriction_begin(Lout), E = Ain.restriction_end(Lout); P != E; ++P)
+            if (Observable.count(P->first) == 0)
+                s.insert(*P);
+    }
 
     S.insertAll(s);
 }
@@ -1027,7 +1106,7 @@ bool isConstant(const Function *Called) {
         return false;
 }
 
-bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, PointsToRelation &Ain, PointsToRelation &Aout, LivenessSet &Lout) {
+bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, const PointsToRelation &Ain, const PointsToRelation *&Aout, const LivenessSet &Lout) {
     if (const CallInst *CI = dyn_cast<CallInst>(I)) {
         if (CI->doesNotReturn()) {
             // If the function does not return, then it doesn't matter what
@@ -1042,7 +1121,7 @@ bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, P
         if (pointsToUnknown) {
             // The function is undefined -- just copy what is already
             // there for monotonicity.
-            s = Aout;
+            s = *Aout;
         }
         else {
             for (const Function *Called : CalledFunctions) {
@@ -1058,11 +1137,14 @@ bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, P
                     addAoutAnalysableCalledFunction(s, Called, CS, CI, Ain, Lout);
             }
         }
-
-        if (s != Aout) {
-            assert(s.isSubset(Aout));
-            Aout.clear();
-            Aout.insertAll(s);
+        // As for lin, the pairs that go around the callee can shrink.
+        if (Summaries || callsMergedFunction(CalledFunctions))
+            s.insertAll(*Aout);
+
+        const PointsToRelation *Interned = facts.intern(s);
+        if (Interned != Aout) {
+            assert(s.isSubset(*Aout));
+            Aout = Interned;
             return true;
         }
         else
@@ -1075,10 +1157,10 @@ bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, P
         subtractKill(CS, notKilled, I, Ain);
         s.unionRelationRestriction(Ain, notKilled);
         insertNewPairs(s, I, Ain, Lout);
-        if (s != Aout) {
-            assert(s.isSubset(Aout));
-            Aout.clear();
-            Aout.insertAll(s);
+        const PointsToRelation *Interned = facts.intern(s);
+        if (Interned != Aout) {
+            assert(s.isSubset(*Aout));
+            Aout = Interned;
             return true;
         }
         else
@@ -1086,8 +1168,91 @@ bool LivenessPointsTo::computeAout(const CallString &CS, const Instruction *I, P
     }
 }
 
-std::set<PointsToNode *> LivenessPointsTo::getKillableDeclaration(const CallInst *CI, PointsToRelation &Ain) {
-    std::set<PointsToNode *> seen, Killable;
+// Inserts the nodes in New that aren't in Old into Added.
+static void insertAddedNodes(LivenessSet &Added, const LivenessSet &New, const LivenessSet &Old) {
+    for (PointsToNode *N : New)
+        if (Old.find(N) == Old.end())
+            Added.insert(N);
+}
+
+static bool containsPair(const PointsToRelation &R, const std::pair<PointsToNode *, PointsToNode *> &P) {
+    for (auto I = R.pointee_begin(P.first), E = R.pointee_end(P.first); I != E; ++I)
+        if (*I == P.second)
+            return true;
+    return false;
+}
+
+// Inserts the pairs in New that aren't in Old into Added.
+static void insertAddedPairs(PointsToRelation &Added, const PointsToRelation &New, const PointsToRelation &Old) {
+    for (auto &P : New)
+        if (!containsPair(Old, P))
+            Added.insert(P);
+}
+
+static bool containsAllNodes(const LivenessSet &L, const LivenessSet &S) {
+    for (PointsToNode *N : S)
+        if (L.find(N) == L.end())
+            return false;
+    return true;
+}
+
+static bool containsAllPairs(const PointsToRelation &R, const PointsToRelation &S) {
+    for (auto &P : S)
+        if (!containsPair(R, P))
+            return false;
+    return true;
+}
+
+// Updates aout after ain has grown from LastAin and lout has grown from
+// LastLout, where aout was computed from LastAin and LastLout. I must not be a
+// call, and the nodes that it kills must not depend on the difference between
+// the ains (which is always true except for stores). The pairs of ain that
+// pass through I are linear in both ain and lout, so only the pairs that are
+// new in ain and the nodes that are new in lout need to be looked at; the pairs
+// that I generates only depend on a few nodes, so they are recomputed.
+bool LivenessPointsTo::propagateAout(const CallString &CS, const Instruction *I, const PointsToRelation &Ain, const PointsToRelation &LastAin, const PointsToRelation *&Aout, const LivenessSet &Lout, const LivenessSet &LastLout) {
+    PointsToRelation s, addedAin;
+    LivenessSet addedLout, addedLive;
+    insertAddedNodes(addedLout, Lout, LastLout);
+    subtractKill(CS, addedLout, I, Ain);
+    s.unionRelationRestriction(Ain, addedLout);
+
+    if (&Ain != &LastAin) {
+        insertAddedPairs(addedAin, Ain, LastAin);
+        for (auto &P : addedAin)
+            if (Lout.find(P.first) != Lout.end())
+                addedLive.insert(P.first);
+        subtractKill(CS, addedLive, I, Ain);
+        s.unionRelationRestriction(addedAin, addedLive);
+    }
+
+    insertNewPairs(s, I, Ain, Lout);
+    if (containsAllPairs(*Aout, s))
+        return false;
+
+    PointsToRelation n = *Aout;
+    n.insertAll(s);
+    Aout = facts.intern(n);
+    return true;
+}
+
+// Updates lin after lout has grown from LastLout, where lin was computed from
+// LastLout. The same conditions as for propagateAout apply.
+bool LivenessPointsTo::propagateLin(const CallString &CS, const Instruction *I, const PointsToRelation &Ain, const LivenessSet *&Lin, const LivenessSet &Lout, const LivenessSet &LastLout) {
+    LivenessSet n;
+    insertAddedNodes(n, Lout, LastLout);
+    subtractKill(CS, n, I, Ain);
+    unionRef(n, I, Lout, Ain);
+    if (containsAllNodes(*Lin, n))
+        return false;
+
+    n.insertAll(*Lin);
+    Lin = facts.intern(n);
+    return true;
+}
+
+PointsToNodeSet LivenessPointsTo::getKillableDeclaration(const CallInst *CI, const PointsToRelation &Ain) {
+    PointsToNodeSet seen, Killable;
     // This is roughly the mark phase from mark-and-sweep garbage collection. We
     // begin with the roots, which are the arguments of the function,  then
     // determine what is reachable using the points-to relation.
@@ -1128,31 +1293,205 @@ std::pair<LivenessSet, PointsToRelation> LivenessPointsTo::getCalledFunctionResu
     if (!data.hasDataForFunction(F))
         return Result;
 
-    IntraproceduralPointsTo *PT = data.get(F, CS);
-    if (PT == nullptr)
+    if (ValueContexts || Summaries) {
+        // With value contexts, the results of the contexts that the call was
+        // bound to before are included too, so that they only grow.
+        auto Found = callBindings.find({F, CS.getNonCyclicPart()});
+        if (Found != callBindings.end())
+            for (CallBinding &B : Found->second)
+                addCalledContextResult(Result, F, B.facts, B.substitution);
         return Result;
+    }
+
+    IntraproceduralPointsTo *PT = data.get(F, CS);
+    if (PT != nullptr)
+        addCalledContextResult(Result, F, PT, Substitution());
+    return Result;
+}
+
+// Adds lin at the start of F and the union of aout at its returns in PT to
+// Result, with the placeholders in them replaced by the objects that they
+// stand for.
+void LivenessPointsTo::addCalledContextResult(std::pair<LivenessSet, PointsToRelation> &Result, const Function *F, IntraproceduralPointsTo *PT, const Substitution &Subst) {
     auto FirstInst = inst_begin(F);
     assert(FirstInst != inst_end(F));
-    auto I = PT->find(&*FirstInst);
-    Result.first = *I->second.first;
+    // The globals that F can't access go around it unchanged.
+    auto Untouched = data.getUntouchedGlobals(PT);
+    LivenessSet Lin = *PT->find(&*FirstInst)->second.first;
+    Lin.insertAll(*Untouched.first);
+    if (Subst.empty())
+        Result.first.insertAll(Lin);
+    else
+        for (PointsToNode *N : Lin)
+            Result.first.insert(substitute(N, Subst, true));
 
     // For Aout, we need to union over all of the PointsToRelations associated
     // with ReturnInsts.
-    PointsToRelation aout;
+    PointsToRelation aout = *Untouched.second;
     for (auto I = inst_begin(F), E = inst_end(F); I != E; ++I) {
         const Instruction *Inst = &*I;
         if (isa<ReturnInst>(Inst)) {
             auto J = PT->find(Inst);
             aout.insertAll(*J->second.second);
+            // The return value is live in lin, and is only used by the
+            // caller if it was live after the return.
+            aout.unionRelationRestriction(*data.getTopLevel(PT), *J->second.first);
         }
     }
-    Result.second = aout;
+    if (Subst.empty())
+        Result.second.insertAll(aout);
+    else
+        for (auto &P : aout)
+            Result.second.insert({substitute(P.first, Subst, true), substitute(P.second, Subst, true)});
+}
 
-    return Result;
+// Returns the function that N, or the object that it is a field of, belongs
+// to, or nullptr if it doesn't belong to one.
+static const Function *getDefiner(const PointsToNode *N) {
+    while (const GEPPointsToNode *G = dyn_cast<GEPPointsToNode>(N))
+        N = G->Parent;
+    if (const ValuePointsToNode *V = dyn_cast<ValuePointsToNode>(N))
+        return V->Definer;
+    if (const NoAliasPointsToNode *NA = dyn_cast<NoAliasPointsToNode>(N))
+        return NA->Definer;
+    return nullptr;
+}
+
+static PointsToNode *getObject(PointsToNode *N) {
+    while (GEPPointsToNode *G = dyn_cast<GEPPointsToNode>(N))
+        N = const_cast<PointsToNode *>(G->Parent);
+    return N;
 }
 
-std::set<PointsToNode *> LivenessPointsTo::getReturnValues(const Function *F) {
-    std::set<PointsToNode *> s;
+// Returns true if Callee, or a function that it may call, can refer to N
+// without being given a pointer to it. Placeholders can only be reached
+// through pointers.
+bool LivenessPointsTo::canName(const Function *Callee, const PointsToNode *N) {
+    if (isa<PlaceholderPointsToNode>(getObject(const_cast<PointsToNode *>(N))))
+        return false;
+    const Function *Definer = getDefiner(N);
+    return Definer == nullptr || Definer == Callee || callGraph.mayCall(Callee, Definer);
+}
+
+// Finds the nodes that Callee can see when it is called with the pointers in
+// Roots and the pairs in R, where L is the liveness after the call: the nodes
+// that it can name, those that can be reached from them and from Roots
+// through R, and the rest of the objects that these are fields of. Order
+// lists them in the order that they were found in, which only depends on the
+// shape of R.
+void LivenessPointsTo::findObservableNodes(const Function *Callee, ArrayRef<PointsToNode *> Roots, const PointsToRelation &R, const LivenessSet &L, SmallPtrSetImpl<PointsToNode *> &Observable, SmallVectorImpl<PointsToNode *> &Order) {
+    SmallVector<PointsToNode *, 16> Queue(Roots.begin(), Roots.end());
+    for (auto &P : R)
+        if (canName(Callee, P.first))
+            Queue.push_back(P.first);
+    for (PointsToNode *N : L)
+        if (canName(Callee, N))
+            Queue.push_back(N);
+
+    std::function<void(PointsToNode *)> insertObject = [&](PointsToNode *N) {
+        Observable.insert(N);
+        Order.push_back(N);
+        if (N->singlePointee())
+            Queue.push_back(N->getSinglePointee());
+        for (auto P = R.pointee_begin(N), E = R.pointee_end(N); P != E; ++P)
+            Queue.push_back(*P);
+        for (PointsToNode *Child : N->children)
+            insertObject(Child);
+    };
+    for (unsigned i = 0; i != Queue.size(); ++i)
+        if (Observable.count(Queue[i]) == 0)
+            insertObject(getObject(Queue[i]));
+}
+
+// Finds the nodes that Called can see at the call CI, in the terms of the
+// caller.
+void LivenessPointsTo::findObservableNodesAtCall(const Function *Called, const CallInst *CI, const PointsToRelation &Ain, const LivenessSet &Lout, SmallPtrSetImpl<PointsToNode *> &Observable) {
+    SmallVector<PointsToNode *, 8> Roots;
+    for (Value *V : CI->arg_operands())
+        Roots.push_back(factory.getNode(V));
+    SmallVector<PointsToNode *, 32> Order;
+    findObservableNodes(Called, Roots, Ain, Lout, Observable, Order);
+    // The return value is defined by the call, so it isn't kept across it.
+    Observable.insert(factory.getNode(CI));
+}
+
+// Maps N through Subst, from a placeholder to the object that it stands for
+// if ToObject is set, or the other way around otherwise. The fields of mapped
+// objects are mapped to the same fields of their images, which are created if
+// necessary.
+PointsToNode *LivenessPointsTo::substitute(PointsToNode *N, const Substitution &Subst, bool ToObject) {
+    if (GEPPointsToNode *G = dyn_cast<GEPPointsToNode>(N)) {
+        PointsToNode *Parent = const_cast<PointsToNode *>(G->Parent);
+        PointsToNode *Image = substitute(Parent, Subst, ToObject);
+        if (Image == Parent)
+            return N;
+        // An object that isn't field-sensitive stands for its fields.
+        if (!Image->isFieldSensitive())
+            return Image;
+
+        for (PointsToNode *Child : Image->children) {
+            GEPPointsToNode *C = cast<GEPPointsToNode>(Child);
+            if (C->NodeType == G->NodeType && C->indices.size() == G->indices.size() &&
+                std::equal(C->indices.begin(), C->indices.end(), G->indices.begin(), [](const APInt &A, const APInt &B) {
+                    return A.getZExtValue() == B.getZExtValue();
+                }))
+                return Child;
+        }
+        return factory.makeChildNode(Image, G->NodeType, G->indices, nullptr);
+    }
+
+    for (auto &P : Subst) {
+        if (ToObject && P.first == N) {
+            // If the placeholder was turned into a summary node while the
+            // context was analysed, then so is the object.
+            if (P.first->isAlwaysSummaryNode() && !cast<PlaceholderPointsToNode>(P.first)->createdAsSummaryNode && !P.second->isAlwaysSummaryNode()) {
+                factory.markAsSummaryNode(P.second);
+            }
+            return P.second;
+        }
+        if (!ToObject && P.second == N)
+            return P.first;
+    }
+    return N;
+}
+
+// Turns the boundary information of a call to Callee with the call string CS
+// into a parametric one. The nodes that Callee can't see are removed from it
+// (the caller keeps their facts across the call), and the objects of the
+// callers that Callee can only reach through pointers are replaced by
+// placeholders, numbered in the order that they are reached from the formal
+// arguments. Calls that only differ in which of their objects they pass then
+// have the same boundary information. Subst is set to the objects that the
+// placeholders stand for.
+void LivenessPointsTo::makeParametric(const CallString &CS, const Function *Callee, PointsToRelation &EntryPointsTo, LivenessSet &ExitLiveness, Substitution &Subst) {
+    SmallVector<PointsToNode *, 8> Formals;
+    for (const Argument &A : Callee->args())
+        Formals.push_back(factory.getNode(&A));
+    SmallPtrSet<PointsToNode *, 32> Observable;
+    SmallVector<PointsToNode *, 32> Order;
+    findObservableNodes(Callee, Formals, EntryPointsTo, ExitLiveness, Observable, Order);
+
+    for (PointsToNode *N : Order) {
+        if ((isa<NoAliasPointsToNode>(N) || isa<PlaceholderPointsToNode>(N)) && !canName(Callee, N)) {
+            PointsToNode *P = factory.getPlaceholder(Subst.size(), N->hasPointerType(), N->isSummaryNode(CS), N->isFieldSensitive());
+            Subst.push_back({P, N});
+        }
+    }
+
+    PointsToRelation R;
+    for (auto &P : EntryPointsTo)
+        if (Observable.count(P.first) != 0)
+            R.insert({substitute(P.first, Subst, false), substitute(P.second, Subst, false)});
+    LivenessSet L;
+    for (PointsToNode *N : ExitLiveness)
+        if (Observable.count(N) != 0)
+            L.insert(substitute(N, Subst, false));
+    EntryPointsTo = R;
+    ExitLiveness = L;
+}
+
+PointsToNodeSet LivenessPointsTo::getReturnValues(const Function *F) {
+    PointsToNodeSet s;
     for (auto I = inst_begin(F), E = inst_end(F); I != E; ++I)
     {
         const Instruction* Inst = &*I;
@@ -1164,7 +1503,7 @@ std::set<PointsToNode *> LivenessPointsTo::getReturnValues(const Function *F) {
 }
 
 
-LivenessSet LivenessPointsTo::computeFunctionExitLiveness(const CallInst *CI, LivenessSet *Lout) {
+LivenessSet LivenessPointsTo::computeFunctionExitLiveness(const CallInst *CI, const LivenessSet *Lout) {
     PointsToNode *CINode = factory.getNode(CI);
 
     LivenessSet L;
@@ -1190,7 +1529,7 @@ LivenessSet LivenessPointsTo::computeFunctionExitLiveness(const CallInst *CI, Li
     return L;
 }
 
-PointsToRelation LivenessPointsTo::replaceActualArgumentsWithFormal(const Function *Callee, const CallInst *CI, PointsToRelation *Ain) {
+PointsToRelation LivenessPointsTo::replaceActualArgumentsWithFormal(const Function *Callee, const CallInst *CI, const PointsToRelation *Ain) {
     SmallVector<std::pair<PointsToNode *, PointsToNode *>, 8> ArgMap;
     auto Arg = Callee->arg_begin();
     PointsToRelation R;
@@ -1205,7 +1544,7 @@ PointsToRelation LivenessPointsTo::replaceActualArgumentsWithFormal(const Functi
         if (Node->singlePointee()) {
             // These nodes won't be seen in the next loop, so insert the correct
             // pairs for them into Ain here.
-            R.insert(makePointsToPair(ANode, Node->getSinglePointee()));
+            R.insert(makePointsToPair(factory, ANode, Node->getSinglePointee()));
         }
 
         ++Arg;
@@ -1217,7 +1556,7 @@ PointsToRelation LivenessPointsTo::replaceActualArgumentsWithFormal(const Functi
             return P.first == I->first;
         });
         if (MapI != MapE)
-            R.insert(makePointsToPair(MapI->second, I->second));
+            R.insert(makePointsToPair(factory, MapI->second, I->second));
         else
             R.insert(*I);
     }
@@ -1268,14 +1607,14 @@ LivenessSet LivenessPointsTo::replaceFormalArgumentsWithActual(const CallString
     return L2;
 }
 
-PointsToRelation LivenessPointsTo::replaceReturnValuesWithCallInst(const CallInst *CI, PointsToRelation &Aout, std::set<PointsToNode *> &ReturnValues, LivenessSet &Lout) {
+PointsToRelation LivenessPointsTo::replaceReturnValuesWithCallInst(const CallInst *CI, PointsToRelation &Aout, PointsToNodeSet &ReturnValues, const LivenessSet &Lout) {
     PointsToNode *CINode = factory.getNode(CI);
     bool CINodeLive = Lout.find(CINode) != Lout.end();
     PointsToRelation R;
     for (auto I = Aout.begin(), E  = Aout.end(); I != E; ++I) {
         if (ReturnValues.find(I->first) != ReturnValues.end()) {
             if (CINodeLive)
-                R.insert(makePointsToPair(CINode, I->second));
+                R.insert(makePointsToPair(factory, CINode, I->second));
         }
         else if (Lout.find(I->first) != Lout.end())
             R.insert(*I);
@@ -1284,54 +1623,204 @@ PointsToRelation LivenessPointsTo::replaceReturnValuesWithCallInst(const CallIns
         for (PointsToNode *N : ReturnValues) {
             if (N->singlePointee()) {
                 // These nodes will not be seen in the previous loop.
-                R.insert(makePointsToPair(CINode, N->getSinglePointee()));
+                R.insert(makePointsToPair(factory, CINode, N->getSinglePointee()));
             }
         }
     }
     return R;
 }
 
-void LivenessPointsTo::runOnFunction(const Function *F, const CallString &CS, IntraproceduralPointsTo *Result, PointsToRelation &EntryPointsTo, LivenessSet &ExitLiveness, bool MakeReturnValuesLive, SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> &Calls) {
+// Returns true if N is an SSA pointer defined in F. These are only given
+// pointees where they are defined (or at the first instruction, for
+// arguments), so their pointees are the same wherever they are live. Fields
+// of SSA pointers are given pointees by the GEPs that index them, but killed
+// where the pointer is defined, so they stay in the relations.
+static bool isTopLevel(const PointsToNode *N, const Function *F) {
+    const ValuePointsToNode *V = dyn_cast<ValuePointsToNode>(N);
+    return V != nullptr && !V->isAlwaysSummaryNode() && V->Definer == F;
+}
+
+const PointsToRelation *LivenessPointsTo::withTopLevel(const PointsToRelation *R, const PointsToRelation *TopLevel, const LivenessSet &L) {
+    if (TopLevel->empty())
+        return R;
+    PointsToRelation s = *R;
+    s.unionRelationRestriction(*TopLevel, L);
+    return facts.intern(s);
+}
+
+// Moves the pairs in R for SSA pointers that are in Live into TopLevel, and
+// sets Rest to the remaining pairs. Returns true if Rest changed.
+bool LivenessPointsTo::splitTopLevel(const Function *F, const PointsToRelation *R, const LivenessSet &Live, const PointsToRelation *&Rest, const PointsToRelation *&TopLevel, LivenessSet &Grown) {
+    PointsToRelation s, t = *TopLevel;
+    for (auto &P : *R) {
+        if (!isTopLevel(P.first, F) || Live.find(P.first) == Live.end())
+            s.insert(P);
+        else if (t.insert(P))
+            Grown.insert(P.first);
+    }
+    if (!Grown.empty())
+        TopLevel = facts.intern(t);
+
+    const PointsToRelation *Interned = facts.intern(s);
+    if (Interned != Rest) {
+        Rest = Interned;
+        return true;
+    }
+    return false;
+}
+
+// Returns true if N is a global, or a field of one, that F and the functions
+// that it calls can't access.
+bool LivenessPointsTo::isUntouchedGlobal(const Function *F, PointsToNode *N) {
+    const GlobalPointsToNode *G = dyn_cast<GlobalPointsToNode>(getObject(N));
+    if (G == nullptr)
+        return false;
+    const GlobalVariable *GV = dyn_cast<GlobalVariable>(G->getObject());
+    return GV != nullptr && !globalModRef.mayAccess(F, GV);
+}
+
+// Moves the globals that F can't access out of the boundary information of
+// the context with the facts Result, and records them for the context. They
+// stay live through F if they are live at its exit, and keep the pairs that
+// they have at its entry. Returns true if the record changed.
+bool LivenessPointsTo::factorGlobals(const Function *F, const IntraproceduralPointsTo *Result, PointsToRelation &EntryPointsTo, LivenessSet &ExitLiveness) {
+    LivenessSet Live, Exit;
+    for (PointsToNode *N : ExitLiveness) {
+        if (isUntouchedGlobal(F, N))
+            Live.insert(N);
+        else
+            Exit.insert(N);
+    }
+    PointsToRelation Pairs, Entry;
+    for (auto &P : EntryPointsTo) {
+        if (!isUntouchedGlobal(F, P.first))
+            Entry.insert(P);
+        else if (Live.find(P.first) != Live.end())
+            Pairs.insert(P);
+    }
+    EntryPointsTo = Entry;
+    ExitLiveness = Exit;
+    auto Record = std::make_pair(facts.intern(Live), facts.intern(Pairs));
+    if (Record == data.getUntouchedGlobals(Result))
+        return false;
+    data.setUntouchedGlobals(Result, Record.first, Record.second);
+    return true;
+}
+
+// Returns true if N or one of its descendants may point to one of Nodes.
+static bool mayPointToAny(PointsToNode *N, const PointsToRelation &Ain, const SmallPtrSetImpl<PointsToNode *> &Nodes) {
+    for (auto P = Ain.pointee_begin(N), E = Ain.pointee_end(N); P != E; ++P)
+        if (Nodes.count(*P) != 0)
+            return true;
+
+    for (PointsToNode *C : N->children)
+        if (mayPointToAny(C, Ain, Nodes))
+            return true;
+
+    return false;
+}
+
+// Returns true if the transfer functions of I depend on whether any of Nodes
+// are summary nodes, when they are given Ain and Lout. Since the facts only
+// grow, this holds for the facts that they were given before as well.
+bool LivenessPointsTo::readsSummaryStatus(const Instruction *I, const PointsToRelation &Ain, const LivenessSet &Lout, const SmallPtrSetImpl<PointsToNode *> &Nodes) {
+    // Instructions don't kill their own nodes if they are summary nodes.
+    if (Nodes.count(factory.getNode(I)) != 0)
+        return true;
+
+    auto anyLive = [&]() {
+        for (PointsToNode *N : Nodes)
+            if (Lout.find(N) != Lout.end())
+                return true;
+        return false;
+    };
+    if (const StoreInst *SI = dyn_cast<StoreInst>(I)) {
+        // Stores update their pointees strongly unless they are summary
+        // nodes, and kill everything but summary nodes if they don't know
+        // their pointees.
+        return anyLive() || mayPointToAny(factory.getNode(SI->getPointerOperand()), Ain, Nodes);
+    }
+    else if (const LoadInst *LI = dyn_cast<LoadInst>(I)) {
+        // The objects that aren't pointers are only kept in the facts if they
+        // are summary nodes.
+        return mayPointToAny(factory.getNode(LI->getPointerOperand()), Ain, Nodes);
+    }
+    else if (const AllocaInst *AI = dyn_cast<AllocaInst>(I)) {
+        return Nodes.count(factory.getNoAliasNode(AI)) != 0;
+    }
+    else if (const CallInst *CI = dyn_cast<CallInst>(I)) {
+        // The facts for summary nodes go around the callee, and the boundary
+        // information that is passed to it depends on the facts here.
+        if (CI->paramHasAttr(0, Attribute::NoAlias) && Nodes.count(factory.getNoAliasNode(CI)) != 0)
+            return true;
+        if (anyLive())
+            return true;
+        for (auto &P : Ain)
+            if (Nodes.count(P.first) != 0 || Nodes.count(P.second) != 0)
+                return true;
+    }
+    return false;
+}
+
+// Finds the nodes of F's flow graph that read whether any of Nodes are summary
+// nodes when their transfer functions were last applied, using the facts that
+// were kept in State.
+void LivenessPointsTo::findSummaryStatusReaders(const Function *F, const IntraproceduralPointsTo *Result, const SolverState &State, ArrayRef<PointsToNode *> Nodes, SmallVectorImpl<unsigned> &Readers) {
+    const FlowGraph &G = data.getFlowGraph(F);
+    const PointsToRelation *TopLevel = data.getTopLevel(Result);
+    SmallPtrSet<PointsToNode *, 8> NodeSet(Nodes.begin(), Nodes.end());
+    for (unsigned N = 0, E = G.size(); N != E; ++N) {
+        const Instruction *I = G.getInstruction(N);
+        auto &Facts = State.nonresult.find(I)->second;
+        const PointsToRelation *Ain = Facts.second;
+        if (TopLevelSSA)
+            Ain = withTopLevel(Ain, TopLevel, *Result->find(I)->second.first);
+        if (readsSummaryStatus(I, *Ain, *Facts.first, NodeSet))
+            Readers.push_back(N);
+    }
+}
+
+bool LivenessPointsTo::runOnFunction(const Function *F, const CallString &CS, IntraproceduralPointsTo *Result, const PointsToRelation &Entry, const LivenessSet &Exit, bool MakeReturnValuesLive, SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> &Calls) {
     timesRanOnFunction++;
     assert(!F->isDeclaration() && "Can only run on definitions.");
 
+    // The callers use the record of the untouched globals as part of the
+    // result, so it changing is a change to the result.
+    PointsToRelation EntryPointsTo = Entry;
+    LivenessSet ExitLiveness = Exit;
+    bool UntouchedGlobalsChanged = FactorGlobals && factorGlobals(F, Result, EntryPointsTo, ExitLiveness);
+
+    // The solver needs the facts at every node of the flow graph, so fill in
+    // any that weren't stored after the last run.
+    data.expandFacts(F, Result);
+    const FlowGraph &G = data.getFlowGraph(F);
+    const PointsToRelation *TopLevel = data.getTopLevel(Result);
+
+    // The solver's state is kept between runs, so that a run can carry on
+    // from the fixed point that the last one reached. If the facts are only
+    // stored at some instructions, the ones that were filled in above are
+    // the same as at the end of the last run, since the instructions between
+    // the stored ones pass the facts through unchanged. The run starts from
+    // scratch if nodes have been created since, because the transfer
+    // functions that have already been applied may not have seen them.
+    std::unique_ptr<SolverState> &Kept = solverStates[Result];
+    if (!Kept)
+        Kept.reset(new SolverState());
+    SolverState *State = Kept.get();
+    bool Resume = !State->nonresult.empty() && State->numIds == PointsToNode::getNumIds();
+    State->numIds = PointsToNode::getNumIds();
+
     // The result of the function is lin and aout (since liveness is propagated
     // backwards and points-to forwards); this variable contains lout and ain.
-    IntraproceduralPointsTo nonresult;
+    IntraproceduralPointsTo &nonresult = State->nonresult;
+    if (!Resume)
+        nonresult.clear();
 
-    // Initialize ain, aout, lin and lout for each instruction, and ensure that
-    // GEPs are handled correctly.
+    // Initialize ain, aout, lin and lout for each node, and ensure that GEPs
+    // are handled correctly.
     for (const_inst_iterator S = inst_begin(F), I = S, E = inst_end(F); I != E; ++I) {
         const Instruction *inst = &*I;
 
-        // If the instruction is a ReturnInst, the values that are live after
-        // the instruction is executed are exactly those specified in
-        // ExitLiveness, if it exists. If the instruction is the first in the
-        // function, the points-to information before it is executed is exactly
-        // that in EntryPointsTo.
-
-        if (const ReturnInst *RI = dyn_cast<ReturnInst>(inst)) {
-            LivenessSet *L = new LivenessSet();
-            L->insertAll(ExitLiveness);
-            if (RI->getReturnValue() != nullptr && MakeReturnValuesLive)
-                L->insert(factory.getNode(RI->getReturnValue()));
-
-            if (I == S) {
-                PointsToRelation *R = new PointsToRelation();
-                R->insertAll(EntryPointsTo);
-                nonresult.insert({inst, {L, R}});
-            }
-            else
-                nonresult.insert({inst, {L, new PointsToRelation()}});
-        }
-        else if (I == S) {
-            PointsToRelation *R = new PointsToRelation();
-            R->insertAll(EntryPointsTo);
-            nonresult.insert({inst, {new LivenessSet(), R}});
-        }
-        else
-            nonresult.insert({inst, {new LivenessSet(), new PointsToRelation()}});
-
         if (const GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(inst)) {
             // If some GEPs which are based on a pointer have all constant
             // indices and some have none-constant indices, then we want to
@@ -1342,106 +1831,258 @@ void LivenessPointsTo::runOnFunction(const Function *F, const CallString &CS, In
             if (!GEP->hasAllConstantIndices())
                 factory.getNode(GEP);
         }
+
+        if (!G.hasNode(inst))
+            continue;
+
+        // If the instruction is a ReturnInst, the values that are live after
+        // the instruction is executed are exactly those specified in
+        // ExitLiveness, if it exists. If the instruction is the first in the
+        // function, the points-to information before it is executed is exactly
+        // that in EntryPointsTo. The facts kept from the last run are left as
+        // they are here.
+
+        const LivenessSet *L = facts.emptyLiveness();
+        const PointsToRelation *R = I == S ? facts.intern(EntryPointsTo) : facts.emptyRelation();
+        if (const ReturnInst *RI = dyn_cast<ReturnInst>(inst)) {
+            LivenessSet l = ExitLiveness;
+            if (RI->getReturnValue() != nullptr && MakeReturnValuesLive)
+                l.insert(factory.getNode(RI->getReturnValue()));
+            L = facts.intern(l);
+        }
+        nonresult.insert({inst, {L, R}});
     }
 
     // Create and initialize worklist. Also initialize the values of Lout and
-    // Ain, since they are not preserved across calls.
-    SmallPtrSet<const Instruction *, 128> worklist;
-    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; I++) {
-        worklist.insert(&*I);
-        auto instruction_nonresult = nonresult.find(&*I), instruction_result = Result->find(&*I);
-        assert (instruction_nonresult != nonresult.end());
-        assert (instruction_result != Result->end());
-        auto instruction_ain = instruction_nonresult->second.second;
-        auto instruction_lin = instruction_result->second.first,
-             instruction_lout = instruction_nonresult->second.first;
-        computeLout(&*I, *instruction_lout, *Result);
-        computeAin(&*I, F, *instruction_ain, *instruction_lin, Result, CS.isEmpty());
+    // Ain, unless they were kept from the last run. The worklist orders the
+    // nodes by their position in the flow graph, so the order in which
+    // instructions are visited doesn't depend on where they were allocated.
+    FlowGraphWorklist worklist(G, Resume);
+
+    // If SSA pointers are treated flow-insensitively, the pairs for the live
+    // ones that end up in ain at the first instruction are moved into the
+    // table, so that the entry pairs of arguments are seen wherever they are
+    // live. The others stay in ain until they become live.
+    auto computeNodeAin = [&](unsigned N, const PointsToRelation *&Ain, const LivenessSet &Lin, LivenessSet &Grown) {
+        if (!TopLevelSSA || N != 0)
+            return computeAin(G, N, F, Ain, Lin, Result, CS.isEmpty());
+        const PointsToRelation *View = withTopLevel(Ain, TopLevel, Lin);
+        computeAin(G, N, F, View, Lin, Result, CS.isEmpty());
+        return splitTopLevel(F, View, Lin, Ain, TopLevel, Grown);
+    };
+
+    // The ain and lout that each node's aout and lin were last computed from.
+    std::vector<const PointsToRelation *> &lastAin = State->lastAin;
+    std::vector<const LivenessSet *> &lastLout = State->lastLout;
+    if (!Resume) {
+        lastAin.assign(G.size(), nullptr);
+        lastLout.assign(G.size(), nullptr);
+    }
+
+    // The nodes that were turned into summary nodes after the first
+    // SummaryNodes may have been updated strongly by the transfer functions
+    // that were applied before. The instructions whose transfer functions
+    // read whether they are summary nodes are looked at again from scratch,
+    // and the calls among them have their callees analysed again, even if
+    // their boundary information hasn't changed.
+    unsigned SummaryNodes = Resume ? State->summaryNodes : factory.getSummaryNodes().size();
+    auto invalidateSummaryNodeReaders = [&]() {
+        ArrayRef<PointsToNode *> Nodes = factory.getSummaryNodes().slice(SummaryNodes);
+        SummaryNodes += Nodes.size();
+        SmallVector<unsigned, 16> Readers;
+        findSummaryStatusReaders(F, Result, *State, Nodes, Readers);
+        for (unsigned N : Readers) {
+            lastAin[N] = nullptr;
+            worklist.addForward(N);
+            if (const CallInst *CI = dyn_cast<CallInst>(G.getInstruction(N))) {
+                const CallStringNode *Node = CS.addCallSite(CI).getNonCyclicPart(),
+                                     *Merged = CS.addMergedCallSite(CI).getNonCyclicPart();
+                for (auto C = callData.begin(), E = callData.end(); C != E; ++C)
+                    if (C->first.second == Node || (C->first.second == Merged && mergedFunctions.count(C->first.first) != 0))
+                        callData.erase(C);
+            }
+        }
+    };
+
+    bool Changed = UntouchedGlobalsChanged, Stopped = false;
+    LivenessSet Grown;
+    // Stores the table of SSA pointers after the pointers in Grown were given
+    // new pairs. The instructions where they are live need to be looked at
+    // again.
+    auto updateTopLevel = [&]() {
+        data.setTopLevel(Result, TopLevel);
+        Changed = true;
+        for (unsigned N = 0, E = G.size(); N != E; ++N) {
+            const LivenessSet *Lin = Result->find(G.getInstruction(N))->second.first;
+            for (PointsToNode *Node : Grown) {
+                if (Lin->find(Node) != Lin->end()) {
+                    worklist.addForward(N);
+                    break;
+                }
+            }
+        }
+    };
+    if (Resume) {
+        for (unsigned N = 0, E = G.size(); N != E; ++N) {
+            // Only the boundary information and the results of the callees can
+            // have changed since the last run, so it is enough to look at the
+            // first instruction, the returns and the calls.
+            const Instruction *I = G.getInstruction(N);
+            auto &Facts = nonresult.find(I)->second;
+            if (const ReturnInst *RI = dyn_cast<ReturnInst>(I)) {
+                LivenessSet l = *Facts.first;
+                l.insertAll(ExitLiveness);
+                if (RI->getReturnValue() != nullptr && MakeReturnValuesLive)
+                    l.insert(factory.getNode(RI->getReturnValue()));
+                const LivenessSet *L = facts.intern(l);
+                if (L != Facts.first) {
+                    Facts.first = L;
+                    worklist.addBackward(N);
+                }
+            }
+            if (N == 0) {
+                PointsToRelation r = *Facts.second;
+                r.insertAll(EntryPointsTo);
+                const PointsToRelation *R = facts.intern(r);
+                if (R != Facts.second) {
+                    Facts.second = R;
+                    computeNodeAin(N, Facts.second, *Result->find(I)->second.first, Grown);
+                    worklist.addForward(N);
+                }
+            }
+            if (isa<CallInst>(I))
+                worklist.addForward(N);
+        }
+        if (SummaryNodes != factory.getSummaryNodes().size())
+            invalidateSummaryNodeReaders();
     }
+    else {
+        for (unsigned N = 0, E = G.size(); N != E; ++N) {
+            const Instruction *I = G.getInstruction(N);
+            auto instruction_nonresult = nonresult.find(I), instruction_result = Result->find(I);
+            assert (instruction_nonresult != nonresult.end());
+            assert (instruction_result != Result->end());
+            const PointsToRelation *&instruction_ain = instruction_nonresult->second.second;
+            const LivenessSet *instruction_lin = instruction_result->second.first,
+                              *&instruction_lout = instruction_nonresult->second.first;
+            computeLout(G, N, instruction_lout, *Result);
+            computeNodeAin(N, instruction_ain, *instruction_lin, Grown);
+        }
+    }
+    if (!Grown.empty())
+        updateTopLevel();
 
     // Update points-to and liveness information until it converges.
     while (!worklist.empty()) {
-        worklistIterations++;
+        if (countIteration(F, CS)) {
+            Stopped = true;
+            break;
+        }
 
-        auto II = worklist.begin();
-        const Instruction *I = *II;
-        worklist.erase(I);
+        unsigned Next = worklist.pop();
+        const Instruction *I = G.getInstruction(Next);
 
         auto instruction_nonresult = nonresult.find(I), instruction_result = Result->find(I);
         assert (instruction_nonresult != nonresult.end());
         assert (instruction_result != Result->end());
-        auto instruction_ain = instruction_nonresult->second.second,
-             instruction_aout = instruction_result->second.second;
-        auto instruction_lin = instruction_result->second.first,
-             instruction_lout = instruction_nonresult->second.first;
+        // These are references to the entries in the maps, so that the
+        // compute functions can replace the interned sets.
+        const PointsToRelation *&instruction_ain = instruction_nonresult->second.second,
+                               *&instruction_aout = instruction_result->second.second;
+        const LivenessSet *&instruction_lin = instruction_result->second.first,
+                          *&instruction_lout = instruction_nonresult->second.first;
+
+        computeLout(G, Next, instruction_lout, *Result);
+
+        // If SSA pointers are treated flow-insensitively, the transfer
+        // functions are given ain with the pairs of the live SSA pointers
+        // added, and any pairs for them that end up in aout are moved into
+        // the table.
+        Grown.clear();
+        const PointsToRelation *Ain = instruction_ain, *Aout = instruction_aout;
+        const LivenessSet *OldLin = instruction_lin;
+        const PointsToRelation *OldAout = instruction_aout;
+        if (TopLevelSSA)
+            Ain = withTopLevel(instruction_ain, TopLevel, *instruction_lin);
+
+        // After the first visit, only the pairs and nodes that were added to
+        // ain and lout since the last visit are propagated through the
+        // instruction, unless it is a call or a store whose ain changed (since
+        // the nodes that a store kills depend on ain). If neither changed,
+        // then neither do aout and lin.
+        const PointsToRelation *LastAin = lastAin[Next];
+        const LivenessSet *LastLout = lastLout[Next];
+        bool Incremental = LastAin != nullptr && !isa<CallInst>(I) && (!isa<StoreInst>(I) || LastAin == Ain);
+        lastAin[Next] = Ain;
+        lastLout[Next] = instruction_lout;
 
-        computeLout(I, *instruction_lout, *Result);
         // Aout depends on Lout, so this call needs to happen after computeLout
         // (or the current instruction should be added to the worklist when
         // computeLout returns true).
-        bool addSuccsToWorklist = computeAout(CS, I, *instruction_ain, *instruction_aout, *instruction_lout);
+        bool addSuccsToWorklist, addPredsToWorklist;
+        if (!Incremental)
+            addSuccsToWorklist = computeAout(CS, I, *Ain, Aout, *instruction_lout);
+        else if (LastAin != Ain || LastLout != instruction_lout)
+            addSuccsToWorklist = propagateAout(CS, I, *Ain, *LastAin, Aout, *instruction_lout, *LastLout);
+        else
+            addSuccsToWorklist = false;
+        if (TopLevelSSA)
+            addSuccsToWorklist = splitTopLevel(F, Aout, *instruction_lout, instruction_aout, TopLevel, Grown);
+        else
+            instruction_aout = Aout;
         // Lin depends on Lout, so this call needs to happen after computeLout
         // (or the current instruction should be added to the worklist when
         // computeLout returns true).
-        bool addPredsToWorklist = computeLin(CS, I, *instruction_ain, *instruction_lin, *instruction_lout);
+        if (!Incremental)
+            addPredsToWorklist = computeLin(CS, I, *Ain, instruction_lin, *instruction_lout);
+        else if (LastLout != instruction_lout || LastAin != Ain)
+            addPredsToWorklist = propagateLin(CS, I, *Ain, instruction_lin, *instruction_lout, *LastLout);
+        else
+            addPredsToWorklist = false;
         // Ain depends on Lin, so this call needs to happen after computeLin
         // (or the current instruction should be added to the worklist when
         // computeLin returns true).
-        bool addCurrToWorklist = computeAin(I, F, *instruction_ain, *instruction_lin, Result, CS.isEmpty());
+        bool addCurrToWorklist = computeNodeAin(Next, instruction_ain, *instruction_lin, Grown);
+        // The ain given to the transfer functions depends on lin as well.
+        if (TopLevelSSA && addPredsToWorklist)
+            addCurrToWorklist = true;
+
+        if (instruction_lin != OldLin || instruction_aout != OldAout)
+            Changed = true;
+
+        if (!Grown.empty())
+            updateTopLevel();
 
         // Add succs to worklist
-        if (addSuccsToWorklist) {
-            if (const TerminatorInst *TI = dyn_cast<TerminatorInst>(I)) {
-                for (unsigned i = 0; i < TI->getNumSuccessors(); i++)
-                    worklist.insert(TI->getSuccessor(i)->begin());
-            }
-            else
-                worklist.insert(getNextInstruction(I));
-        }
+        if (addSuccsToWorklist)
+            for (unsigned Succ : G.succs(Next))
+                worklist.addForward(Succ);
 
         // Add current instruction to worklist
         if (addCurrToWorklist)
-            worklist.insert(I);
+            worklist.addForward(Next);
 
         // Add preds to worklist
-        if (addPredsToWorklist) {
-            const BasicBlock *BB = I->getParent();
-            const Instruction *FirstInBB = BB->begin();
-            if (FirstInBB == I) {
-                for (const_pred_iterator PI = pred_begin(BB), E = pred_end(BB);
-                     PI != E;
-                     ++PI) {
-                    const BasicBlock *Pred = *PI;
-                    worklist.insert(--(Pred->end()));
-                }
-            }
-            else
-                worklist.insert(getPreviousInstruction(I));
-        }
+        if (addPredsToWorklist)
+            for (unsigned Pred : G.preds(Next))
+                worklist.addBackward(Pred);
 
-        if (worklist.empty() && createdSummaryNode) {
-            createdSummaryNode = false;
-            // Need to rerun on calls even if the data passed to them has not
-            // changed.
-            callData.clear();
-            // We need to rerun on stores because they might need to treat a
-            // summary node differently.
-            for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; I++)
-                if (isa<StoreInst>(*I))
-                    worklist.insert(&*I);
-        }
+        if (worklist.empty() && SummaryNodes != factory.getSummaryNodes().size())
+            invalidateSummaryNodeReaders();
     }
 
     // Determine the boundary information to use when running the analysis on
     // the called functions.
+    auto Untouched = data.getUntouchedGlobals(Result);
     for (auto I = inst_begin(F), E = inst_end(F); I != E; ++I) {
         if (const CallInst *CI = dyn_cast<CallInst>(&*I)) {
             auto instruction_nonresult = nonresult.find(CI);
             assert (instruction_nonresult != nonresult.end());
             auto Ain = instruction_nonresult->second.second;
+            if (TopLevelSSA)
+                Ain = withTopLevel(Ain, TopLevel, *Result->find(CI)->second.first);
 
             PointsToNode *CINode = factory.getNode(CI);
-            CallString newCS = CS.addCallSite(&*I);
             SmallVector<const Function *, 8> CalledFunctions;
             bool pointsToUnknown = getCalledFunctions(CalledFunctions, CI, *Ain);
 
@@ -1450,13 +2091,16 @@ void LivenessPointsTo::runOnFunction(const Function *F, const CallString &CS, In
                     if (!Called->isDeclaration()) {
                         auto instruction_nonresult = nonresult.find(&*I);
                         assert (instruction_nonresult != nonresult.end());
-                        auto instruction_ain = instruction_nonresult->second.second;
                         auto instruction_lout = instruction_nonresult->second.first;
 
                         // Add to the list of calls made by the function for analysis later.
-                        auto EntryPT = replaceActualArgumentsWithFormal(Called, CI, instruction_ain);
+                        auto EntryPT = replaceActualArgumentsWithFormal(Called, CI, Ain);
                         auto ExitL = computeFunctionExitLiveness(CI, instruction_lout);
                         bool RVL = instruction_lout->find(CINode) != instruction_lout->end();
+                        // The callees can't access the globals that F can't
+                        // access either, so they are passed on to them.
+                        EntryPT.insertAll(*Untouched.second);
+                        ExitL.insertAll(*Untouched.first);
 
                         Calls.push_back(std::make_tuple(CI, Called, EntryPT, ExitL, RVL));
                     }
@@ -1465,12 +2109,75 @@ void LivenessPointsTo::runOnFunction(const Function *F, const CallString &CS, In
         }
     }
 
-    for (auto P : nonresult) {
-        LivenessSet *L = P.second.first;
-        PointsToRelation *R = P.second.second;
-        delete L;
-        delete R;
+    State->summaryNodes = SummaryNodes;
+    data.compactFacts(F, Result);
+    // The worklist wasn't emptied, so the next run can't carry on from here.
+    if (Stopped)
+        solverStates.erase(Result);
+    return Changed;
+}
+
+// Returns the call string for the call Call from CS to Called. The calls to
+// the functions that went over -lfcpa-function-budget forget their callers.
+CallString LivenessPointsTo::getCallString(const CallString &CS, const Instruction *Call, const Function *Called) const {
+    if (mergedFunctions.count(Called) != 0)
+        return CS.addMergedCallSite(Call);
+    return CS.addCallSite(Call);
+}
+
+// Returns true if the calls that reached F with CS now use a merged context
+// instead, because F went over its budget.
+bool LivenessPointsTo::isMergedAway(const Function *F, const CallString &CS) const {
+    return !CS.isEmpty() && !CS.isMerged() && mergedFunctions.count(F) != 0;
+}
+
+bool LivenessPointsTo::callsMergedFunction(ArrayRef<const Function *> CalledFunctions) const {
+    return std::any_of(CalledFunctions.begin(), CalledFunctions.end(), [&](const Function *Called) {
+        return mergedFunctions.count(Called) != 0;
+    });
+}
+
+// Counts an iteration of the worklist of F in the context with CS, and
+// returns true if the context shouldn't be analysed any further, either
+// because the analysis was stopped or because F went over its own budget.
+bool LivenessPointsTo::countIteration(const Function *F, const CallString &CS) {
+    worklistIterations++;
+    if (IterationBudget != 0 && worklistIterations - startIterations > IterationBudget)
+        stopAnalysis("its iteration budget");
+    else if ((worklistIterations & 1023) == 0) {
+        // Reading the clock on every iteration would slow the solver down.
+        if (TimeBudget != 0 && std::chrono::steady_clock::now() - startTime > std::chrono::seconds(TimeBudget))
+            stopAnalysis("its time budget");
+        else if (FactBudget != 0 && facts.getBytes() > ((size_t)FactBudget << 20))
+            stopAnalysis("its fact budget");
+    }
+    if (incomplete)
+        return true;
+
+    if (FunctionBudget == 0 || ++functionIterations[F] <= FunctionBudget || mergedFunctions.count(F) != 0)
+        return false;
+    // The value contexts are already shared by the calls with the same
+    // boundary information, and merging them further would mean joining
+    // their boundaries, so the analysis gives up on the module instead.
+    if (ValueContexts || Summaries) {
+        stopAnalysis("the iteration budget of " + F->getName());
+        return true;
     }
+    // The roots are only analysed in their own contexts, and the merged
+    // contexts can't be merged any further.
+    if (CS.isEmpty() || CS.isMerged())
+        return false;
+    errs() << "Warning: " << F->getName() << " went over its iteration budget, so the calls to it share a context for each call site\n";
+    mergedFunctions.insert(F);
+    return true;
+}
+
+// Stops the analysis before it reaches a fixed point. The facts are then
+// missing pairs, so the queries are answered by the unification pre-pass.
+void LivenessPointsTo::stopAnalysis(const Twine &Reason) {
+    if (!incomplete)
+        errs() << "Warning: the analysis went over " << Reason << ", so it was stopped and only the unification pre-pass is used to answer queries\n";
+    incomplete = true;
 }
 
 bool LivenessPointsTo::runOnFunctionAt(const CallString& CS,
@@ -1479,97 +2186,408 @@ bool LivenessPointsTo::runOnFunctionAt(const CallString& CS,
                                        LivenessSet &ExitLiveness,
                                        bool MakeReturnValuesLive,
                                        bool AlwaysRerun) {
+    if (incomplete)
+        return false;
     bool Changed = true;
-    IntraproceduralPointsTo *Out = data.getPointsTo(CS, F, EntryPointsTo, ExitLiveness, Changed);
+    const PointsToRelation *EntryPT = facts.intern(EntryPointsTo);
+    const LivenessSet *ExitL = facts.intern(ExitLiveness);
+    IntraproceduralPointsTo *Out = data.getPointsTo(CS, F, EntryPT, ExitL, MakeReturnValuesLive, Changed);
     if (!AlwaysRerun && !Changed) {
         // If the boundary information has not changed since the analysis was
         // last run on this function, then there is no need to run it again.
         return false;
     }
-    IntraproceduralPointsTo Copy = copyPointsToMap(Out);
+    if (CS.isTruncated()) {
+        // The boundary information has been merged with that of the other
+        // contexts that share the truncated call string.
+        EntryPointsTo = *EntryPT;
+        ExitLiveness = *ExitL;
+    }
     SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> Calls;
-    runOnFunction(F, CS, Out, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, Calls);
+    unsigned NumIds = PointsToNode::getNumIds();
+    bool eq = !runOnFunction(F, CS, Out, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, Calls);
+    for (auto &C : Calls)
+        callGraph.addCall(F, std::get<1>(C));
+    if (incomplete)
+        return false;
+    // If F went over its budget, the caller has to be analysed again to use
+    // the merged context.
+    if (isMergedAway(F, CS))
+        return true;
+
+    // If F is recursive, the information here may feed back into its own
+    // boundary information, so it has to stop changing before the callees
+    // are looked at. Otherwise, the callees are looked at before returning,
+    // so that the caller only needs to be rerun once the whole subtree has
+    // converged.
+    bool Recursive = CS.containsCallIn(F) || callGraph.isRecursive(F);
+    if (!eq && !Recursive && NumIds != PointsToNode::getNumIds()) {
+        // A run of the analysis reaches a fixed point for the current results
+        // of the callees, unless it created nodes (such as the fields that
+        // GEPs index), since then the earlier transfer functions may not have
+        // seen them. In that case, run it again.
+        runOnFunctionAt(CS, F, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, true);
+        return true;
+    }
+    if (!eq && Recursive) {
+        // Since the information at the caller depends on the information
+        // here, rerun the analysis at the caller. We don't need to rerun it on
+        // the callees yet because the caller will rerun on it's callees if
+        // neccessary.
+        if (!CS.isEmpty())
+            return true;
+        // If there is no caller, then rerun the analysis here. We'll consider
+        // the callees when a fixed point is reached.
+        return runOnFunctionAt(CS, F, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, true);
+    }
+
+    // If there is a prefix with the same information, then make it cyclic. If
+    // a cyclic call string is created and then the analysis is rerun with a
+    // matching call string, it is removed; this deals with cases where a
+    // cyclic call string is created prematurely.
+    if (eq && data.attemptMakeCyclicCallString(F, CS, Out))
+        return false;
+
+    // If there is no prefix with the same information, then we need to look
+    // further down the tree until we reach a leaf or find one, so run the
+    // analysis on the callees. The analysis doesn't need to be rerun on the
+    // caller here for the same reason as above. If the information at a
+    // callee changes, then they will rerun the analysis here.
+    bool rerun = false;
+
+    for (auto &C : Calls) {
+        const CallInst *I = std::get<0>(C);
+        const Function *F = std::get<1>(C);
+        PointsToRelation &PT = std::get<2>(C);
+        LivenessSet &L = std::get<3>(C);
+        bool RVL = std::get<4>(C);
+
+        CallString newCS = getCallString(CS, I, F);
+
+        // The call strings here are never cyclic, so the call string's
+        // node identifies it.
+        CallBoundary Boundary = {facts.intern(PT), facts.intern(L), RVL};
+        auto Key = std::make_pair(F, newCS.getNonCyclicPart());
+        auto Inserted = callData.insert({Key, Boundary});
+        if (!Inserted.second) {
+            CallBoundary &Last = Inserted.first->second;
+            if (Last.entryPointsTo == Boundary.entryPointsTo && Last.exitLiveness == Boundary.exitLiveness && Last.returnValuesLive == RVL)
+                continue;
+            else
+                Last = Boundary;
+        }
+        rootCalls.insert({Key, newCS});
+
+        // If an earlier root reached F with the same boundary information,
+        // then the analysis would reach the facts that it did, so the call
+        // uses its map. A call that was given a map stops sharing it when its
+        // boundary information changes to something that wasn't seen before.
+        bool Shared = sharedCalls.count(Key) != 0;
+        if (Shared || data.get(F, newCS) == nullptr) {
+            if (IntraproceduralPointsTo *Converged = findConvergedContext(newCS, F, Boundary)) {
+                rerun |= data.get(F, newCS) != Converged;
+                data.shareContext(newCS, F, Converged, Boundary.entryPointsTo, Boundary.exitLiveness);
+                sharedCalls.insert(Key);
+                continue;
+            }
+        }
+        if (Shared) {
+            data.removeContext(newCS, F);
+            sharedCalls.erase(Key);
+        }
+
+        rerun |= runOnFunctionAt(newCS, F, PT, L, RVL, false);
+    }
+    if (rerun)
+        return runOnFunctionAt(CS, F, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, true) || !eq;
+    else
+        return !eq;
+}
 
-    bool eq = arePointsToMapsEqual(F, Out, Copy);
+// A function analysed in a value context. The context is analysed with a
+// call string of its own, so that the calls in it are bound to contexts
+// independently of the other contexts. Uses is the number of calls that are
+// bound to it, callers are the contexts that have used its results and
+// callees are the contexts that its calls are bound to.
+struct ValueContext {
+    const Function *function;
+    CallString callString;
+    IntraproceduralPointsTo *facts;
+    const PointsToRelation *entryPointsTo;
+    const LivenessSet *exitLiveness;
+    bool returnValuesLive;
+    unsigned uses;
+    SmallVector<unsigned, 4> callers, callees;
+    bool queued;
+};
+
+// Analyses each function once for each value context that it is reached in,
+// that is, for each distinct boundary information at its calls, rather than
+// for each call string. The contexts are analysed from a worklist: a context
+// is added to it when it is created, when the results of a context that it
+// calls change, or when a call in it is bound to another context. Since there
+// are finitely many contexts, this terminates without making any call strings
+// cyclic.
+void LivenessPointsTo::runWithValueContexts(Module &M, ArrayRef<Function *> RootFunctions) {
+    std::vector<ValueContext> Contexts;
+    DenseMap<const IntraproceduralPointsTo *, unsigned> Numbers;
+    std::deque<unsigned> Worklist;
+    callGraph.addDirectCalls(M, unification);
+
+    auto enqueue = [&](unsigned C) {
+        if (!Contexts[C].queued) {
+            Contexts[C].queued = true;
+            Worklist.push_back(C);
+        }
+    };
+    // Returns the context for a call with the call string CS, and sets
+    // NewResults if the call can now use results that it couldn't before.
+    auto getContext = [&](const CallString &CS, const Function *F, const PointsToRelation *EntryPT, const LivenessSet *ExitL, bool RVL, const Substitution &Subst, bool &NewResults) {
+        IntraproceduralPointsTo *Previous;
+        bool Created;
+        // The summary nodes of the functions that F can't call can only be in
+        // the boundary information of a parametric context as placeholders.
+        auto Relevant = [&](const Function *G) {
+            return !Summaries || G == F || callGraph.mayCall(F, G);
+        };
+        IntraproceduralPointsTo *Out = data.getValueContext(CS, F, EntryPT, ExitL, RVL, Relevant, Previous, Created);
+        if (Previous != nullptr && Previous != Out)
+            Contexts[Numbers.find(Previous)->second].uses--;
+
+        SmallVector<CallBinding, 1> &Bindings = callBindings[{F, CS.getNonCyclicPart()}];
+        NewResults = std::none_of(Bindings.begin(), Bindings.end(), [&](const CallBinding &B) {
+            return B.facts == Out && B.substitution == Subst;
+        });
+        if (NewResults)
+            Bindings.push_back({Out, Subst});
+        // A new context has no results yet; its callers are analysed again
+        // when it has some.
+        NewResults &= !Created;
+
+        if (Created) {
+            unsigned C = Contexts.size();
+            Numbers[Out] = C;
+            Contexts.push_back({F, CS.isEmpty() ? CS : CS.makeUnique(), Out, EntryPT, ExitL, RVL, 1, {}, {}, false});
+            enqueue(C);
+            return C;
+        }
 
-    for (auto P : Copy) {
-        LivenessSet *L = P.second.first;
-        PointsToRelation *R = P.second.second;
-        delete L;
-        delete R;
+        unsigned C = Numbers.find(Out)->second;
+        // If no calls were bound to the context, then it wasn't analysed
+        // again when the contexts that it calls changed.
+        if (Previous != Out && Contexts[C].uses++ == 0)
+            enqueue(C);
+        return C;
+    };
+
+    // Each root is analysed with the empty call string.
+    for (Function *F : RootFunctions) {
+        bool NewResults;
+        getContext(callStrings.empty(), F, facts.emptyRelation(), facts.emptyLiveness(), true, Substitution(), NewResults);
     }
 
-    if (eq) {
-        // If there is a prefix with the same information, then make it
-        // cyclic. If a cyclic call string is created and then the analysis is
-        // rerun with a matching call string, it is removed; this deals with
-        // cases where a cyclic call string is created prematurely.
-        if (data.attemptMakeCyclicCallString(F, CS, Out))
-            return false;
+    unsigned SummaryNodes = factory.getSummaryNodes().size();
+    while (!incomplete) {
+        while (!Worklist.empty()) {
+            unsigned C = Worklist.front();
+            Worklist.pop_front();
+            Contexts[C].queued = false;
+            // A context that no calls are bound to isn't needed any more.
+            if (Contexts[C].uses == 0)
+                continue;
+            const Function *F = Contexts[C].function;
+            CallString CS = Contexts[C].callString;
+            IntraproceduralPointsTo *Out = Contexts[C].facts;
+            PointsToRelation EntryPointsTo = *Contexts[C].entryPointsTo;
+            LivenessSet ExitLiveness = *Contexts[C].exitLiveness;
+
+            SmallVector<std::tuple<const CallInst *, const Function *, PointsToRelation, LivenessSet, bool>, 8> Calls;
+            unsigned NumIds = PointsToNode::getNumIds();
+            bool eq = !runOnFunction(F, CS, Out, EntryPointsTo, ExitLiveness, Contexts[C].returnValuesLive, Calls);
+            if (incomplete)
+                break;
 
-        // If there is no prefix with the same information, then we need to look
-        // further down the tree until we reach a leaf or find one, so run the
-        // analysis on the callees. The analysis doesn't need to be rerun on the
-        // caller here for the same reason as above. If the information at a
-        // callee changes, then they will rerun the analysis here.
-        bool rerun = false;
-
-        for (auto C : Calls) {
-            const CallInst *I;
-            const Function *F;
-            PointsToRelation PT;
-            LivenessSet L;
-            bool RVL;
-            std::tie(I, F, PT, L, RVL) = C;
-
-            CallString newCS = CS.addCallSite(I);
-
-            auto Iter = std::find_if(callData.begin(), callData.end(), [&](std::tuple<CallString, const Function *, PointsToRelation, LivenessSet, bool> D) {
-                CallString CS = std::get<0>(D);
-                const Function *IF = std::get<1>(D);
-                return CS.matches(newCS) && IF == F;
-            });
-
-            if (Iter != callData.end()) {
-                auto LastData = *Iter;
-                PointsToRelation LastPT = std::get<2>(LastData);
-                LivenessSet LastL = std::get<3>(LastData);
-                bool LastRVL = std::get<4>(LastData);
-                if (LastPT == PT && LastL == L && LastRVL == RVL)
-                    continue;
-                else
-                    *Iter = std::make_tuple(newCS, F, PT, L, RVL);
+            // If nodes were created, the earlier transfer functions may not
+            // have seen them, so the context needs to be analysed again.
+            bool Rerun = NumIds != PointsToNode::getNumIds();
+            SmallVector<unsigned, 4> Callees;
+            for (auto &Call : Calls) {
+                const Function *Called = std::get<1>(Call);
+                CallString NewCS = CS.addCallSite(std::get<0>(Call));
+                PointsToRelation &EntryPT = std::get<2>(Call);
+                LivenessSet &ExitL = std::get<3>(Call);
+                Substitution Subst;
+                callGraph.addCall(F, Called);
+                if (Summaries)
+                    makeParametric(NewCS, Called, EntryPT, ExitL, Subst);
+
+                bool NewResults;
+                unsigned Callee = getContext(NewCS, Called, facts.intern(EntryPT), facts.intern(ExitL), std::get<4>(Call), Subst, NewResults);
+                SmallVector<unsigned, 4> &Callers = Contexts[Callee].callers;
+                if (std::find(Callers.begin(), Callers.end(), C) == Callers.end())
+                    Callers.push_back(C);
+                Callees.push_back(Callee);
+                Rerun |= NewResults;
+            }
+            Contexts[C].callees = Callees;
+
+            if (!eq)
+                for (unsigned Caller : Contexts[C].callers)
+                    enqueue(Caller);
+            if (Rerun)
+                enqueue(C);
+        }
+
+        if (incomplete || factory.getSummaryNodes().size() == SummaryNodes)
+            break;
+        // The nodes that were turned into summary nodes may have been updated
+        // strongly in the contexts that were analysed before, so analyse the
+        // contexts that read whether they are summary nodes again (or all of
+        // them, if they have no solver state).
+        SummaryNodes = factory.getSummaryNodes().size();
+        for (unsigned C = 0, E = Contexts.size(); C != E; ++C) {
+            if (Contexts[C].uses == 0)
+                continue;
+            auto Found = solverStates.find(Contexts[C].facts);
+            if (Found == solverStates.end()) {
+                enqueue(C);
+                continue;
             }
+            SolverState &State = *Found->second;
+            SmallVector<unsigned, 16> Readers;
+            findSummaryStatusReaders(Contexts[C].function, Contexts[C].facts, State, factory.getSummaryNodes().slice(State.summaryNodes), Readers);
+            if (!Readers.empty())
+                enqueue(C);
             else
-                callData.push_back(std::make_tuple(newCS, F, PT, L, RVL));
+                State.summaryNodes = SummaryNodes;
+        }
+    }
 
-            rerun |= runOnFunctionAt(newCS, F, PT, L, RVL, false);
+    // Only keep the contexts that can be reached from the roots through the
+    // calls as they are bound now; the others were made for boundary
+    // information that has since grown.
+    SmallPtrSet<const IntraproceduralPointsTo *, 32> Reached;
+    SmallVector<unsigned, 32> Stack;
+    for (unsigned C = 0, E = Contexts.size(); C != E; ++C)
+        if (Contexts[C].callString.isEmpty())
+            Stack.push_back(C);
+    while (!Stack.empty()) {
+        unsigned C = Stack.pop_back_val();
+        if (Reached.insert(Contexts[C].facts).second)
+            Stack.append(Contexts[C].callees.begin(), Contexts[C].callees.end());
+    }
+    data.removeValueContexts(Reached);
+    callBindings.clear();
+}
+
+// Returns the map of a context that converged under an earlier root, which F
+// can be analysed in with the boundary information of a call with CS. The
+// summary nodes must be the same as when the context converged, and the call
+// strings must not differ in the functions that F may call (see
+// CallString::reachesSameFunctions). Returns nullptr if there isn't one.
+IntraproceduralPointsTo *LivenessPointsTo::findConvergedContext(const CallString &CS, const Function *F, const CallBoundary &Boundary) {
+    // Recursive functions and truncated call strings have contexts that
+    // depend on their callers.
+    if (CS.isTruncated() || callGraph.isRecursive(F))
+        return nullptr;
+    auto Found = convergedContexts.find({F, {Boundary.entryPointsTo, Boundary.exitLiveness}});
+    if (Found == convergedContexts.end())
+        return nullptr;
+    auto Relevant = [&](const Function *G) {
+        return G == F || callGraph.mayCall(F, G);
+    };
+    for (ConvergedContext &C : Found->second)
+        if (C.returnValuesLive == Boundary.returnValuesLive && C.summaryNodes == factory.getSummaryNodes().size() && C.callString.reachesSameFunctions(CS, Relevant))
+            return C.facts;
+    return nullptr;
+}
+
+// Adds the contexts that were reached from the root that was just analysed
+// to the converged contexts, so that the later roots can use them.
+void LivenessPointsTo::addConvergedContexts() {
+    for (auto &C : rootCalls) {
+        const Function *F = C.first.first;
+        const CallString &CS = C.second;
+        auto Boundary = callData.find(C.first);
+        if (Boundary == callData.end() || sharedCalls.count(C.first) != 0 || CS.isTruncated() || callGraph.isRecursive(F) || mergedFunctions.count(F) != 0)
+            continue;
+        IntraproceduralPointsTo *Out = data.get(F, CS);
+        if (Out == nullptr)
+            continue;
+        const CallBoundary &B = Boundary->second;
+        convergedContexts[{F, {B.entryPointsTo, B.exitLiveness}}].push_back({CS, Out, B.returnValuesLive, (unsigned)factory.getSummaryNodes().size()});
+    }
+    rootCalls.clear();
+    sharedCalls.clear();
+}
+
+// Finds the functions to start the analysis from, as chosen by -lfcpa-root or
+// -lfcpa-roots. Only the functions that they call, directly or indirectly, are
+// analysed, in the contexts that reach them.
+void LivenessPointsTo::getRoots(Module &M, SmallVectorImpl<Function *> &RootFunctions) {
+    if (!RootNames.empty()) {
+        for (const std::string &Name : RootNames) {
+            Function *F = M.getFunction(Name);
+            if (F == nullptr || F->isDeclaration())
+                errs() << "Warning: the root " << Name << " isn't defined in the module\n";
+            else if (std::find(RootFunctions.begin(), RootFunctions.end(), F) == RootFunctions.end())
+                RootFunctions.push_back(F);
         }
-        if (rerun)
-            return runOnFunctionAt(CS, F, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, true);
-        else
-            return false;
+        return;
     }
-    else {
-        // Since the information at the caller depends on the information here,
-        // rerun the analysis at the caller. We don't need to rerun it on the
-        // callees yet because the caller will rerun on it's callees if
-        // neccessary.
-        if (!CS.isEmpty())
-            return true;
-        // If there is no caller, then rerun the analysis here. We'll consider
-        // the callees when a fixed point is reached.
-        return runOnFunctionAt(CS, F, EntryPointsTo, ExitLiveness, MakeReturnValuesLive, true);
+
+    for (Function &F : M) {
+        if (F.isDeclaration())
+            continue;
+        switch (Roots) {
+            case AllRoots:
+                RootFunctions.push_back(&F);
+                break;
+            case MainRoot:
+                if (F.getName() == "main")
+                    RootFunctions.push_back(&F);
+                break;
+            case ExternalRoots:
+                // Code outside the module can call the functions that it can
+                // see, and the ones whose addresses escape to it.
+                if (!F.hasLocalLinkage() || F.hasAddressTaken())
+                    RootFunctions.push_back(&F);
+                break;
+        }
     }
 }
 
 void LivenessPointsTo::runOnModule(Module &M) {
-    for (Function &F : M) {
-        if (!F.isDeclaration()) {
+    startTime = std::chrono::steady_clock::now();
+    startIterations = worklistIterations;
+    if (Unification)
+        unification.compute(M);
+    if (FactorGlobals)
+        globalModRef.compute(M, unification);
+
+    SmallVector<Function *, 16> RootFunctions;
+    getRoots(M, RootFunctions);
+    if (ValueContexts || Summaries)
+        runWithValueContexts(M, RootFunctions);
+    else {
+        callGraph.addDirectCalls(M, unification);
+        // Each root is analysed with the empty call string. The call strings
+        // that are reached from different roots are different, so the order
+        // that the roots are analysed in doesn't matter.
+        for (Function *F : RootFunctions) {
+            if (incomplete)
+                break;
             callData.clear();
             LivenessSet L;
             PointsToRelation R;
-            runOnFunctionAt(CallString::empty(), &F, R, L, true, true);
+            runOnFunctionAt(callStrings.empty(), F, R, L, true, true);
+            addConvergedContexts();
         }
     }
+    // The solver's state is only needed while the analysis runs.
+    solverStates.clear();
+    // If the analysis was stopped, the queries are answered by the
+    // unification pre-pass alone, so run it if it wasn't run already.
+    if (incomplete && !Unification)
+        unification.compute(M);
 }
@@ -1,10 +1,212 @@
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "LivenessSet.h"
 
+void LivenessSet::growToInclude(unsigned First, unsigned EndW) {
+    if (words.empty()) {
+        firstWord = First;
+        words.resize(EndW - First, 0);
+        return;
+    }
+
+    if (First < firstWord) {
+        words.insert(words.begin(), firstWord - First, 0);
+        firstWord = First;
+    }
+    if (EndW > endWord())
+        words.resize(EndW - firstWord, 0);
+}
+
+void LivenessSet::trim() {
+    unsigned Leading = 0;
+    while (Leading < words.size() && words[Leading] == 0)
+        ++Leading;
+    if (Leading == words.size()) {
+        words.clear();
+        firstWord = 0;
+        return;
+    }
+    while (words.back() == 0)
+        words.pop_back();
+    if (Leading > 0) {
+        words.erase(words.begin(), words.begin() + Leading);
+        firstWord += Leading;
+    }
+}
+
+bool LivenessSet::setBit(unsigned Id) {
+    unsigned W = Id / BitsPerWord;
+    growToInclude(W, W + 1);
+    uint64_t &Word = words[W - firstWord];
+    uint64_t Mask = uint64_t(1) << (Id % BitsPerWord);
+    if (Word & Mask)
+        return false;
+    Word |= Mask;
+    return true;
+}
+
+bool LivenessSet::clearBit(unsigned Id) {
+    if (!testBit(Id))
+        return false;
+    unsigned W = Id / BitsPerWord;
+    words[W - firstWord] &= ~(uint64_t(1) << (Id % BitsPerWord));
+    if (words[W - firstWord] == 0)
+        trim();
+    return true;
+}
+
+LivenessSet::size_type LivenessSet::eraseNode(PointsToNode *N) {
+    if (large) {
+        if (!clearBit(N->getId()))
+            return 0;
+    }
+    else {
+        auto I = std::lower_bound(small.begin(), small.end(), N, PointsToNodeLess());
+        if (I == small.end() || *I != N)
+            return 0;
+        small.erase(I);
+    }
+    --count;
+    return 1;
+}
+
+void LivenessSet::makeLarge() {
+    assert(!large);
+    large = true;
+    for (PointsToNode *N : small)
+        setBit(N->getId());
+    small.clear();
+}
+
+void LivenessSet::makeSmall() {
+    assert(large && count <= SmallSize);
+    for (unsigned Id = findNextBit(firstWord * BitsPerWord); Id != End; Id = findNextBit(Id + 1))
+        small.push_back(PointsToNode::getById(Id));
+    words.clear();
+    firstWord = 0;
+    large = false;
+}
+
+void LivenessSet::insertAll(const LivenessSet &L) {
+    if (L.empty())
+        return;
+
+    if (!large && !L.large) {
+        SmallVector<PointsToNode *, SmallSize * 2> merged;
+        std::set_union(small.begin(), small.end(), L.small.begin(), L.small.end(), std::back_inserter(merged), PointsToNodeLess());
+        if (merged.size() <= SmallSize) {
+            small.assign(merged.begin(), merged.end());
+            count = small.size();
+            return;
+        }
+        makeLarge();
+        for (PointsToNode *N : merged)
+            setBit(N->getId());
+        count = merged.size();
+        return;
+    }
+
+    if (!large)
+        makeLarge();
+
+    if (L.large) {
+        growToInclude(L.firstWord, L.endWord());
+        unsigned Offset = L.firstWord - firstWord;
+        for (unsigned i = 0, e = L.words.size(); i != e; ++i)
+            words[Offset + i] |= L.words[i];
+    }
+    else {
+        for (PointsToNode *N : L.small)
+            setBit(N->getId());
+    }
+
+    count = 0;
+    for (uint64_t W : words)
+        count += countPopulation(W);
+}
+
+bool LivenessSet::operator==(const LivenessSet &R) const {
+    if (count != R.count)
+        return false;
+
+    if (!large && !R.large)
+        return small == R.small;
+    if (large && R.large)
+        return firstWord == R.firstWord && words == R.words;
+
+    // The sets have the same size but different representations, so it is
+    // enough to check that one contains the other.
+    const LivenessSet &Small = large ? R : *this, &Large = large ? *this : R;
+    for (PointsToNode *N : Small.small)
+        if (!Large.testBit(N->getId()))
+            return false;
+    return true;
+}
+
+unsigned LivenessSet::hash() const {
+    hash_code H = hash_value(count);
+    for (PointsToNode *N : *this)
+        H = hash_combine(H, N->getId());
+    return H;
+}
+
+bool LivenessSet::isSubset(const LivenessSet &S) const {
+    if (!large || !S.large) {
+        for (auto N : S) {
+            if (N->isAlwaysSummaryNode())
+                continue;
+
+            if (find(N) == end())
+                return false;
+        }
+        return true;
+    }
+
+    // Check a word at a time, only looking at the individual nodes that are
+    // in S but not in this set.
+    for (unsigned W = S.firstWord, E = S.endWord(); W != E; ++W) {
+        uint64_t Missing = S.words[W - S.firstWord];
+        if (W >= firstWord && W < endWord())
+            Missing &= ~words[W - firstWord];
+        while (Missing != 0) {
+            unsigned Bit = countTrailingZeros(Missing);
+            Missing &= Missing - 1;
+            if (!PointsToNode::getById(W * BitsPerWord + Bit)->isAlwaysSummaryNode())
+                return false;
+        }
+    }
+    return true;
+}
+
+void LivenessSet::eraseNonSummaryNodes(const CallString &CS) {
+    if (!large) {
+        auto NewEnd = std::remove_if(small.begin(), small.end(), [&](PointsToNode *N) {
+            return !N->isSummaryNode(CS);
+        });
+        small.erase(NewEnd, small.end());
+        count = small.size();
+        return;
+    }
+
+    for (unsigned W = firstWord, E = endWord(); W != E; ++W) {
+        uint64_t &Word = words[W - firstWord];
+        for (uint64_t Bits = Word; Bits != 0; Bits &= Bits - 1) {
+            unsigned Bit = countTrailingZeros(Bits);
+            if (!PointsToNode::getById(W * BitsPerWord + Bit)->isSummaryNode(CS)) {
+                Word &= ~(uint64_t(1) << Bit);
+                --count;
+            }
+        }
+    }
+    trim();
+    if (count <= SmallSize / 2)
+        makeSmall();
+}
+
 void LivenessSet::dump() const {
     bool first = true;
-    for (auto N : s) {
+    for (auto N : *this) {
         if (!first)
             errs() << ", ";
         first = false;
@@ -12,4 +214,3 @@ void LivenessSet::dump() const {
     }
     errs() << "\n";
 }
-
@@ -1,39 +1,80 @@
+#include <algorithm>
+
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
 
+#include "LivenessPointsToMisc.h"
 #include "PointsToData.h"
 
+static cl::opt<bool> BlockFacts("lfcpa-block-facts",
+    cl::desc("Only store the facts at block boundaries and pointer-relevant instructions"),
+    cl::init(false));
+
+static cl::opt<bool> SparseFlow("lfcpa-sparse",
+    cl::desc("Only propagate facts between pointer-relevant instructions"),
+    cl::init(false));
+
 ProcedurePointsTo *PointsToData::getAtFunction(const Function *F) const {
     auto result = data.find(F);
-    assert (result != data.end() && "The points-to data does not contain an entry for the specified function.");
+    // The functions that weren't reached from the roots have no contexts.
+    if (result == data.end())
+        return &noContexts;
     return result->second;
 }
 
 bool arePointsToMapsEqual(const Function *F, IntraproceduralPointsTo *a, IntraproceduralPointsTo &b) {
     for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
         auto p1 = a->find(&*I), p2 = b.find(&*I);
-        assert(p1 != a->end() && p2 != b.end() && "Invalid points-to relations");
-        LivenessSet *l1 = p1->second.first, *l2 = p2->second.first;
-        if (*l1 != *l2)
-            return false;
-        PointsToRelation *r1 = p1->second.second, *r2 = p2->second.second;
-        if (*r1 != *r2)
+        // Both maps store facts at the same instructions, and the facts at the
+        // others are determined by them.
+        assert((p1 == a->end()) == (p2 == b.end()) && "Invalid points-to relations");
+        if (p1 == a->end())
+            continue;
+        // The sets are interned, so they are equal only if they are the same.
+        if (p1->second != p2->second)
             return false;
     }
     return true;
 }
 
-IntraproceduralPointsTo copyPointsToMap(IntraproceduralPointsTo *M) {
-    IntraproceduralPointsTo Result;
-    for (auto P : *M) {
-        LivenessSet *L = new LivenessSet(*P.second.first);
-        PointsToRelation *R = new PointsToRelation(*P.second.second);
-        Result.insert(std::make_pair(P.first, std::make_pair(L, R)));
+void PointsToData::reindex(const Function *F) {
+    ContextIndex &Index = index[F];
+    Index.exact.clear();
+    Index.cyclic.clear();
+    ProcedurePointsTo &V = *data[F];
+    for (unsigned i = 0, e = V.size(); i != e; ++i) {
+        const CallString &ICS = std::get<0>(V[i]);
+        if (ICS.isCyclic())
+            Index.cyclic[ICS.getNonCyclicPart()].push_back(i);
+        else
+            Index.exact[ICS.getNonCyclicPart()] = i;
+    }
+}
+
+int PointsToData::findCyclicMatch(const ContextIndex &Index, const ProcedurePointsTo &V, const CallString &CS) const {
+    // A cyclic call string can only match CS if its non-cyclic part is a
+    // prefix of CS. If several match, use the first entry, as a scan of the
+    // entries would.
+    int Found = -1;
+    if (Index.cyclic.empty())
+        return Found;
+    for (const CallStringNode *N = CS.getNonCyclicPart(); N != nullptr; N = N->getParent()) {
+        auto I = Index.cyclic.find(N);
+        if (I == Index.cyclic.end())
+            continue;
+        for (unsigned i : I->second)
+            if ((Found == -1 || (int)i < Found) && std::get<0>(V[i]).matches(CS))
+                Found = i;
     }
-    return Result;
+    return Found;
 }
 
-IntraproceduralPointsTo *PointsToData::getPointsTo(const CallString &CS, const Function *F, PointsToRelation &EntryPT, LivenessSet &ExitL, bool &Changed) {
+// If the call string has been truncated, then the contexts that it stands for
+// share their facts, so the boundary information that is stored for it is
+// merged with EntryPT, ExitL and ReturnValuesLive, which are replaced by the
+// merged information.
+IntraproceduralPointsTo *PointsToData::getPointsTo(const CallString &CS, const Function *F, const PointsToRelation *&EntryPT, const LivenessSet *&ExitL, bool &ReturnValuesLive, bool &Changed) {
     assert (!CS.isCyclic() && "Information has already been computed.");
 
     auto P = data.find(F);
@@ -44,42 +85,153 @@ IntraproceduralPointsTo *PointsToData::getPointsTo(const CallString &CS, const F
     }
     else
         Pointsto = P->second;
+    ContextIndex &Index = index[F];
 
-    for (auto I = Pointsto->begin(), E = Pointsto->end(); I != E; ++I) {
-        CallString ICS = std::get<0>(*I);
-        if (ICS.isCyclic() && ICS.matches(CS)) {
-            // We need to remove the call string completely here because it may
-            // have been made cyclic prematurely. It is possible to break here
-            // because the removal of call strings in
-            // attemptMakeCyclicCallString ensures that others do not match.
-            Pointsto->erase(I);
-            break;
-        }
-        if (CS == ICS) {
-            auto IData = std::get<1>(*I);
-            PointsToRelation IPT = std::get<2>(*I);
-            LivenessSet IL = std::get<3>(*I);
-            if (IPT == EntryPT && IL == ExitL) {
-                Changed = false;
-                return IData;
-            }
-            else {
-                *I = std::make_tuple(ICS, IData, IPT, IL);
-                Changed = true;
-                return IData;
+    int Cyclic = findCyclicMatch(Index, *Pointsto, CS);
+    if (Cyclic != -1) {
+        // We need to remove the call string completely here because it may
+        // have been made cyclic prematurely. The removal of call strings in
+        // attemptMakeCyclicCallString ensures that no other entry matches.
+        Pointsto->erase(Pointsto->begin() + Cyclic);
+        reindex(F);
+    }
+    else {
+        auto Exact = Index.exact.find(CS.getNonCyclicPart());
+        if (Exact != Index.exact.end()) {
+            auto &I = (*Pointsto)[Exact->second];
+            auto IData = std::get<1>(I);
+            const PointsToRelation *IPT = std::get<2>(I);
+            const LivenessSet *IL = std::get<3>(I);
+            bool RVLChanged = false;
+            if (CS.isTruncated()) {
+                PointsToRelation PT = *IPT;
+                PT.insertAll(*EntryPT);
+                LivenessSet L = *IL;
+                L.insertAll(*ExitL);
+                bool &RVL = returnValuesLive[IData];
+                RVLChanged = !RVL && ReturnValuesLive;
+                RVL |= ReturnValuesLive;
+                std::get<2>(I) = EntryPT = facts.intern(PT);
+                std::get<3>(I) = ExitL = facts.intern(L);
+                ReturnValuesLive = RVL;
             }
+            Changed = RVLChanged || IPT != EntryPT || IL != ExitL;
+            return IData;
         }
     }
 
     // The call string wasn't found.
-    IntraproceduralPointsTo *Out = new IntraproceduralPointsTo();
-    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
-        Out->insert({&*I, {new LivenessSet(), new PointsToRelation()}});
+    IntraproceduralPointsTo *Out = createFacts(F);
+    index[F].exact[CS.getNonCyclicPart()] = Pointsto->size();
     Pointsto->push_back(std::make_tuple(CS, Out, EntryPT, ExitL));
+    if (CS.isTruncated())
+        returnValuesLive[Out] = ReturnValuesLive;
     Changed = true;
     return Out;
 }
 
+// Returns an empty map for the facts of F.
+IntraproceduralPointsTo *PointsToData::createFacts(const Function *F) {
+    IntraproceduralPointsTo *Out = new IntraproceduralPointsTo();
+    const FlowGraph &G = getFlowGraph(F);
+    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+        if (SparseFlow ? G.hasNode(&*I) : !BlockFacts || isFactStoredAt(&*I))
+            Out->insert({&*I, {facts.emptyLiveness(), facts.emptyRelation()}});
+    return Out;
+}
+
+// Returns the map of the value context of F with the given boundary
+// information, creating it if there isn't one, and makes it the map for CS.
+// The contexts are shared by the call strings that reach the same functions
+// (see CallString::reachesSameFunctions), since the summary nodes depend on
+// them; only the functions that Relevant holds for are compared. Previous is
+// set to the map that CS was used for before, if any, and Created is set if
+// the context is new.
+IntraproceduralPointsTo *PointsToData::getValueContext(const CallString &CS, const Function *F, const PointsToRelation *EntryPT, const LivenessSet *ExitL, bool ReturnValuesLive, function_ref<bool(const Function *)> Relevant, IntraproceduralPointsTo *&Previous, bool &Created) {
+    assert (!CS.isCyclic() && "Value contexts have non-cyclic call strings.");
+
+    ProcedurePointsTo *&Pointsto = data[F];
+    if (Pointsto == nullptr)
+        Pointsto = new ProcedurePointsTo();
+    unsigned &Bound = index[F].exact.insert({CS.getNonCyclicPart(), Pointsto->size()}).first->second;
+    Previous = Bound == Pointsto->size() ? nullptr : std::get<1>((*Pointsto)[Bound]);
+
+    IntraproceduralPointsTo *Out = nullptr;
+    SmallVector<unsigned, 1> &Contexts = valueContexts[F][{EntryPT, ExitL}];
+    for (unsigned i : Contexts) {
+        auto &I = (*Pointsto)[i];
+        if (returnValuesLive[std::get<1>(I)] == ReturnValuesLive && std::get<0>(I).reachesSameFunctions(CS, Relevant)) {
+            Out = std::get<1>(I);
+            Bound = i;
+            break;
+        }
+    }
+    Created = Out == nullptr;
+    if (Created) {
+        Out = createFacts(F);
+        Bound = Pointsto->size();
+        Contexts.push_back(Pointsto->size());
+        Pointsto->push_back(std::make_tuple(CS, Out, EntryPT, ExitL));
+        returnValuesLive[Out] = ReturnValuesLive;
+    }
+
+    return Out;
+}
+
+// Removes the value contexts whose maps aren't in Keep, and the call strings
+// that are mapped to them.
+void PointsToData::removeValueContexts(const SmallPtrSetImpl<const IntraproceduralPointsTo *> &Keep) {
+    for (auto &P : data) {
+        ProcedurePointsTo &V = *P.second;
+        SmallVector<int, 8> Numbers(V.size(), -1);
+        unsigned Kept = 0;
+        for (unsigned i = 0, e = V.size(); i != e; ++i) {
+            if (Keep.count(std::get<1>(V[i])) == 0)
+                continue;
+            Numbers[i] = Kept;
+            V[Kept++] = V[i];
+        }
+        V.erase(V.begin() + Kept, V.end());
+
+        DenseMap<const CallStringNode *, unsigned> &Exact = index[P.first].exact;
+        for (auto I = Exact.begin(), E = Exact.end(); I != E; ++I) {
+            if (Numbers[I->second] == -1)
+                Exact.erase(I);
+            else
+                I->second = Numbers[I->second];
+        }
+    }
+    valueContexts.clear();
+}
+
+// Makes Out, the map of a context that has already converged, the map for CS
+// too, so that the calls with CS use its results without analysing F again.
+void PointsToData::shareContext(const CallString &CS, const Function *F, IntraproceduralPointsTo *Out, const PointsToRelation *EntryPT, const LivenessSet *ExitL) {
+    assert (!CS.isCyclic() && !CS.isTruncated() && "Only exact call strings can share a context.");
+
+    ProcedurePointsTo *&Pointsto = data[F];
+    if (Pointsto == nullptr)
+        Pointsto = new ProcedurePointsTo();
+    auto Inserted = index[F].exact.insert({CS.getNonCyclicPart(), Pointsto->size()});
+    if (Inserted.second)
+        Pointsto->push_back(std::make_tuple(CS, Out, EntryPT, ExitL));
+    else
+        (*Pointsto)[Inserted.first->second] = std::make_tuple(CS, Out, EntryPT, ExitL);
+}
+
+// Removes the entry for CS, so that the next call with it gets a new map.
+void PointsToData::removeContext(const CallString &CS, const Function *F) {
+    auto P = data.find(F);
+    if (P == data.end())
+        return;
+    ContextIndex &Index = index[F];
+    auto Exact = Index.exact.find(CS.getNonCyclicPart());
+    if (Exact == Index.exact.end())
+        return;
+    P->second->erase(P->second->begin() + Exact->second);
+    reindex(F);
+}
+
 bool PointsToData::attemptMakeCyclicCallString(const Function *F, const CallString &CS, IntraproceduralPointsTo *Out) {
     assert(!CS.isCyclic() && "The call string must be non-cyclic");
 
@@ -93,41 +245,56 @@ bool PointsToData::attemptMakeCyclicCallString(const Function *F, const CallStri
     assert(pair != data.end());
 
     ProcedurePointsTo *V = pair->second;
+    const ContextIndex &Index = index[F];
+
+    // Only the entries whose non-cyclic part is a proper prefix of CS can be
+    // extended, so collect them from the index and try them in order.
+    SmallVector<unsigned, 8> Candidates;
+    for (const CallStringNode *N = CS.getNonCyclicPart()->getParent(); N != nullptr; N = N->getParent()) {
+        auto Exact = Index.exact.find(N);
+        if (Exact != Index.exact.end())
+            Candidates.push_back(Exact->second);
+        auto Cyclic = Index.cyclic.find(N);
+        if (Cyclic != Index.cyclic.end())
+            Candidates.append(Cyclic->second.begin(), Cyclic->second.end());
+    }
+    std::sort(Candidates.begin(), Candidates.end());
+
     // If the set already contains a pair of a call string s such that
     // CS = S . S' and a points to map which matches Out, then the call
     // string in the pair can be replaced with S . S'*, since adding an
     // extra S' to the end does not change the points to map.
-    auto I = V->begin(), E = V->end();
-    for (; I != E; ++I) {
-        auto ICS = std::get<0>(*I);
-        auto IData = std::get<1>(*I);
-        auto IPT = std::get<2>(*I);
-        auto IL = std::get<3>(*I);
-        if ((ICS.isEmpty() || ICS.getLastCall() == LastCall || (LastCalledFunction != nullptr && ICS.getLastCalledFunction() == LastCalledFunction)) &&
+    for (unsigned i : Candidates) {
+        auto &I = (*V)[i];
+        const CallString &ICS = std::get<0>(I);
+        auto IData = std::get<1>(I);
+        auto IPT = std::get<2>(I);
+        auto IL = std::get<3>(I);
+        // The repeated part has to start in F. The empty string is F's own
+        // root, so CS has to start there too, rather than at another root
+        // that happens to give F the same facts.
+        if ((ICS.isEmpty() ? CS.getFirstCall()->getParent()->getParent() == F : ICS.getLastCall() == LastCall || (LastCalledFunction != nullptr && ICS.getLastCalledFunction() == LastCalledFunction)) &&
             CS.isNonCyclicPrefix(ICS) &&
-            arePointsToMapsEqual(F, IData, *Out)) {
-            CallString newCS = CS.createCyclicFromPrefix(ICS);
-            *I = std::make_tuple(newCS, Out, IPT, IL);
-            break;
-        }
-    }
+            arePointsToMapsEqual(F, IData, *Out) &&
+            getTopLevel(IData) == getTopLevel(Out) &&
+            getUntouchedGlobals(IData) == getUntouchedGlobals(Out)) {
+            CallString R = CS.createCyclicFromPrefix(ICS);
+            I = std::make_tuple(R, Out, IPT, IL);
 
-    if (I != E) {
-        auto ICS = std::get<0>(*I);
-        CallString R = ICS;
-        // Remove all call strings that match the inserted one.
-        for (auto I2 = V->begin(); I2 != E; ) {
-            if (I != I2 && !std::get<0>(*I2).isCyclic() && R.matches(std::get<0>(*I2))) {
-                I2 = V->erase(I2);
-                E = V->end();
+            // Remove all call strings that match the inserted one.
+            unsigned Kept = 0;
+            for (unsigned j = 0, e = V->size(); j != e; ++j) {
+                const CallString &JCS = std::get<0>((*V)[j]);
+                if (j == i || JCS.isCyclic() || !R.matches(JCS))
+                    (*V)[Kept++] = (*V)[j];
             }
-            else
-                ++I2;
+            V->erase(V->begin() + Kept, V->end());
+            reindex(F);
+            return true;
         }
-        return true;
     }
-    else
-        return false;
+
+    return false;
 }
 
 bool PointsToData::hasDataForFunction(const Function *F) const {
@@ -144,13 +311,168 @@ IntraproceduralPointsTo *PointsToData::get(const Function *F, const CallString &
     if (I == data.end())
         return nullptr;
 
-    ProcedurePointsTo *V = I->second;
-    for (auto P : *V) {
-        auto PCS = std::get<0>(P);
-        auto PData = std::get<1>(P);
-        if (PCS.matches(CS))
-            return PData;
-    }
+    const ProcedurePointsTo &V = *I->second;
+    const ContextIndex &Index = index.find(F)->second;
+    int Cyclic = findCyclicMatch(Index, V, CS);
+    auto Exact = Index.exact.find(CS.getNonCyclicPart());
+    if (Exact != Index.exact.end() && (Cyclic == -1 || (int)Exact->second < Cyclic))
+        return std::get<1>(V[Exact->second]);
+    if (Cyclic != -1)
+        return std::get<1>(V[Cyclic]);
 
     return nullptr;
 }
+
+const FlowGraph &PointsToData::getFlowGraph(const Function *F) {
+    std::unique_ptr<FlowGraph> &G = graphs[F];
+    if (!G)
+        G.reset(new FlowGraph(F, SparseFlow));
+    return *G;
+}
+
+const PointsToRelation *PointsToData::getTopLevel(const IntraproceduralPointsTo *Facts) const {
+    auto Found = topLevel.find(Facts);
+    return Found == topLevel.end() ? facts.emptyRelation() : Found->second;
+}
+
+void PointsToData::setTopLevel(const IntraproceduralPointsTo *Facts, const PointsToRelation *R) {
+    topLevel[Facts] = R;
+}
+
+std::pair<const LivenessSet *, const PointsToRelation *> PointsToData::getUntouchedGlobals(const IntraproceduralPointsTo *Facts) const {
+    auto Found = untouchedGlobals.find(Facts);
+    if (Found == untouchedGlobals.end())
+        return {facts.emptyLiveness(), facts.emptyRelation()};
+    return Found->second;
+}
+
+void PointsToData::setUntouchedGlobals(const IntraproceduralPointsTo *Facts, const LivenessSet *Live, const PointsToRelation *Pairs) {
+    untouchedGlobals[Facts] = {Live, Pairs};
+}
+
+std::pair<const LivenessSet *, const PointsToRelation *> PointsToData::getFactsAt(const IntraproceduralPointsTo *Facts, const Instruction *I) {
+    auto Result = getStoredFactsAt(Facts, I);
+    // The globals that the function can't access are live everywhere in it,
+    // with the pairs that they had at its entry.
+    auto Untouched = getUntouchedGlobals(Facts);
+    if (!Untouched.first->empty()) {
+        LivenessSet Lin = *Result.first;
+        Lin.insertAll(*Untouched.first);
+        PointsToRelation Aout = *Result.second;
+        Aout.insertAll(*Untouched.second);
+        Result = {facts.intern(Lin), facts.intern(Aout)};
+    }
+    const PointsToRelation *TopLevel = getTopLevel(Facts);
+    if (TopLevel->empty())
+        return Result;
+
+    // Add the pairs of the SSA pointers that are live after I. If I is a
+    // node, that is what its successors need; otherwise I passes liveness
+    // through, and lout is lin. The return value is always treated as live
+    // after a return.
+    const FlowGraph &G = getFlowGraph(I->getParent()->getParent());
+    LivenessSet Lout;
+    if (isa<ReturnInst>(I) || !G.hasNode(I) || Facts->find(I) == Facts->end())
+        Lout = *Result.first;
+    else
+        for (unsigned N : G.succs(G.getNode(I)))
+            Lout.insertAll(*getStoredFactsAt(Facts, G.getInstruction(N)).first);
+
+    PointsToRelation Aout = *Result.second;
+    Aout.unionRelationRestriction(*TopLevel, Lout);
+    return {Result.first, facts.intern(Aout)};
+}
+
+std::pair<const LivenessSet *, const PointsToRelation *> PointsToData::getStoredFactsAt(const IntraproceduralPointsTo *Facts, const Instruction *I) {
+    auto Found = Facts->find(I);
+    if (Found != Facts->end())
+        return Found->second;
+
+    if (SparseFlow) {
+        // I isn't a node of the sparse graph, so lin is the union of the lins
+        // of the nodes it reaches and aout is what reaches it from the nodes
+        // before it, restricted to lin.
+        const FlowGraph &G = getFlowGraph(I->getParent()->getParent());
+        SmallVector<unsigned, 4> Before, After;
+        G.getSurroundingNodes(I, Before, After);
+        LivenessSet L;
+        for (unsigned N : After)
+            L.insertAll(*Facts->find(G.getInstruction(N))->second.first);
+        const LivenessSet *Lin = facts.intern(L);
+        PointsToRelation Aout;
+        for (unsigned N : Before)
+            Aout.unionRelationRestriction(*Facts->find(G.getInstruction(N))->second.second, *Lin);
+        return {Lin, facts.intern(Aout)};
+    }
+
+    // I is in the middle of a block and isn't pointer-relevant, so neither are
+    // the instructions between it and the closest stored ones on either side.
+    // Replaying computeLin and computeAout over them isn't needed: each one has
+    // a single predecessor and successor and kills, uses and generates
+    // nothing, so its lin is its lout and its aout is its ain restricted to
+    // it. Lin is therefore the lin of the next stored instruction, and aout is
+    // the aout of the previous one restricted to that, which is what the
+    // default mode computes.
+    assert(BlockFacts && !isFactStoredAt(I) && "The facts should be stored.");
+    const Instruction *Prev = I, *Next = I;
+    do {
+        Prev = getPreviousInstruction(Prev);
+    } while (Facts->find(Prev) == Facts->end());
+    do {
+        Next = getNextInstruction(Next);
+    } while (Facts->find(Next) == Facts->end());
+
+    const LivenessSet *Lin = Facts->find(Next)->second.first;
+    PointsToRelation Aout;
+    Aout.unionRelationRestriction(*Facts->find(Prev)->second.second, *Lin);
+    return {Lin, facts.intern(Aout)};
+}
+
+void PointsToData::expandFacts(const Function *F, IntraproceduralPointsTo *Facts) const {
+    // The sparse solver only needs the facts at the nodes of its graph.
+    if (!BlockFacts || SparseFlow)
+        return;
+
+    // Fill in the facts at the instructions between each pair of stored ones.
+    // They are all the same, so they are only computed once for each gap.
+    for (const BasicBlock &BB : *F) {
+        SmallVector<const Instruction *, 8> Missing;
+        const PointsToRelation *PrevAout = nullptr;
+        for (const Instruction &I : BB) {
+            auto Found = Facts->find(&I);
+            if (Found == Facts->end()) {
+                Missing.push_back(&I);
+                continue;
+            }
+
+            auto Stored = Found->second;
+            if (!Missing.empty()) {
+                PointsToRelation Aout;
+                Aout.unionRelationRestriction(*PrevAout, *Stored.first);
+                const PointsToRelation *Interned = facts.intern(Aout);
+                for (const Instruction *M : Missing)
+                    Facts->insert({M, {Stored.first, Interned}});
+                Missing.clear();
+            }
+            PrevAout = Stored.second;
+        }
+        assert(Missing.empty() && "The terminator should be stored.");
+    }
+}
+
+void PointsToData::compactFacts(const Function *F, IntraproceduralPointsTo *Facts) const {
+    if (!BlockFacts || SparseFlow)
+        return;
+
+    // Build a new map rather than erasing from the old one, since erasing
+    // doesn't release any memory.
+    IntraproceduralPointsTo Compacted;
+    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+        if (isFactStoredAt(&*I)) {
+            auto Found = Facts->find(&*I);
+            assert(Found != Facts->end());
+            Compacted.insert(*Found);
+        }
+    }
+    Facts->swap(Compacted);
+}
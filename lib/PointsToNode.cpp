@@ -1,3 +1,4 @@
 #include "PointsToNode.h"
 
 int PointsToNode::nextId = 0;
+std::vector<PointsToNode *> PointsToNode::nodesById;
@@ -35,7 +35,7 @@ bool PointsToNodeFactory::matchGEPNode(const GEPOperator *I, const PointsToNode
     return false;
 }
 
-PointsToNode *PointsToNodeFactory::getGEPNode(const GEPOperator *I, const Type *Type, PointsToNode *Parent, PointsToNode *Pointee) const {
+PointsToNode *PointsToNodeFactory::getGEPNode(const GEPOperator *I, const Type *Type, PointsToNode *Parent, PointsToNode *Pointee) {
     // We use a special representation of GEPs which can be analysed to
     // implement field-sensitivity. Multiple values can map to the same GEP node
     // (when the GEP has the same pointer operand and indices).  Note that
@@ -47,7 +47,7 @@ PointsToNode *PointsToNodeFactory::getGEPNode(const GEPOperator *I, const Type *
         }
     }
 
-    return new GEPPointsToNode(Parent, Type, I, Pointee);
+    return new (gepNodes.Allocate()) GEPPointsToNode(Parent, Type, I, Pointee);
 }
 
 PointsToNode* PointsToNodeFactory::getNode(const Value *V) {
@@ -107,7 +107,7 @@ PointsToNode* PointsToNodeFactory::getNode(const Value *V) {
                 if (CI->paramHasAttr(0, Attribute::NoAlias))
                     Pointee = getNoAliasNode(CI);
             }
-            Node = new ValuePointsToNode(V, Pointee);
+            Node = new (valueNodes.Allocate()) ValuePointsToNode(V, Pointee);
         }
 
         map.insert(std::make_pair(V, Node));
@@ -120,7 +120,7 @@ PointsToNode* PointsToNodeFactory::getNoAliasNode(const AllocaInst *I) {
     if (KV != noAliasMap.end())
         return KV->second;
     else {
-        PointsToNode *Node = new NoAliasPointsToNode(I);
+        PointsToNode *Node = new (noAliasNodes.Allocate()) NoAliasPointsToNode(I);
         noAliasMap.insert(std::make_pair(I, Node));
         return Node;
     }
@@ -131,7 +131,7 @@ PointsToNode* PointsToNodeFactory::getNoAliasNode(const CallInst *I) {
     if (KV != noAliasMap.end())
         return KV->second;
     else {
-        PointsToNode *Node = new NoAliasPointsToNode(I);
+        PointsToNode *Node = new (noAliasNodes.Allocate()) NoAliasPointsToNode(I);
         noAliasMap.insert(std::make_pair(I, Node));
         return Node;
     }
@@ -142,7 +142,7 @@ PointsToNode* PointsToNodeFactory::getGlobalNode(const GlobalObject *V) {
     if (KV != globalMap.end())
         return KV->second;
     else {
-        PointsToNode *Node = new GlobalPointsToNode(V);
+        PointsToNode *Node = new (globalNodes.Allocate()) GlobalPointsToNode(V);
         globalMap.insert(std::make_pair(V, Node));
         return Node;
     }
@@ -157,5 +157,21 @@ PointsToNode *PointsToNodeFactory::getIndexedNode(PointsToNode *A, const GEPOper
             return Child;
 
     // We create a new GEP node which has A as its parent.
-    return new GEPPointsToNode(A, GEP->getType()->getPointerElementType(), GEP->idx_begin(), GEP->idx_end(), nullptr);
+    return new (gepNodes.Allocate()) GEPPointsToNode(A, GEP->getType()->getPointerElementType(), GEP->idx_begin(), GEP->idx_end(), nullptr);
+}
+
+PointsToNode *PointsToNodeFactory::getPlaceholder(unsigned Index, bool Pointer, bool Summary, bool FieldSensitive) {
+    PointsToNode *&Node = placeholderMap[Index * 8 + FieldSensitive * 4 + Pointer * 2 + Summary];
+    if (Node == nullptr || Node->isAlwaysSummaryNode() != Summary)
+        Node = new (placeholderNodes.Allocate()) PlaceholderPointsToNode(numPlaceholders++, Pointer, Summary, FieldSensitive);
+    return Node;
+}
+
+PointsToNode *PointsToNodeFactory::makeChildNode(PointsToNode *Parent, const Type *Type, const SmallVector<APInt, 8> &Indices, PointsToNode *Pointee) {
+    return new (gepNodes.Allocate()) GEPPointsToNode(Parent, Type, Indices, Pointee);
+}
+
+void PointsToNodeFactory::markAsSummaryNode(PointsToNode *N) {
+    N->markAsSummaryNode();
+    summaryNodes.push_back(N);
 }
@@ -1,10 +1,93 @@
+#include <algorithm>
+
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "PointsToRelation.h"
 
+void PointsToRelation::unionPointees(unsigned Id, const PointeeList &Pointees) {
+    PointeeList &L = s[Id];
+    if (L.empty()) {
+        L = Pointees;
+        count += Pointees.size();
+        return;
+    }
+
+    PointeeList Merged;
+    std::set_union(L.begin(), L.end(), Pointees.begin(), Pointees.end(), std::back_inserter(Merged), PointsToNodeLess());
+    count += Merged.size() - L.size();
+    L.swap(Merged);
+}
+
+void PointsToRelation::insertAll(const PointsToRelation &R) {
+    for (auto &P : R.s)
+        unionPointees(P.first, P.second);
+}
+
+void PointsToRelation::unionRelationRestriction(const PointsToRelation &R, const LivenessSet &S) {
+    // Iterate over whichever of S and the domain of R is smaller, looking up
+    // the nodes in the other.
+    if ((unsigned)S.size() <= R.s.size()) {
+        for (PointsToNode *N : S) {
+            auto I = R.s.find(N->getId());
+            if (I != R.s.end())
+                unionPointees(N->getId(), I->second);
+        }
+    }
+    else {
+        for (auto &P : R.s)
+            if (S.find(PointsToNode::getById(P.first)) != S.end())
+                unionPointees(P.first, P.second);
+    }
+}
+
+bool PointsToRelation::operator==(const PointsToRelation &R) const {
+    if (count != R.count || s.size() != R.s.size())
+        return false;
+
+    for (auto &P : s) {
+        auto I = R.s.find(P.first);
+        if (I == R.s.end() || I->second != P.second)
+            return false;
+    }
+    return true;
+}
+
+bool PointsToRelation::isSubset(const PointsToRelation &R) const {
+    for (auto &P : R.s) {
+        if (PointsToNode::getById(P.first)->isAlwaysSummaryNode())
+            continue;
+
+        auto I = s.find(P.first);
+        if (I == s.end())
+            return false;
+        if (!std::includes(I->second.begin(), I->second.end(), P.second.begin(), P.second.end(), PointsToNodeLess()))
+            return false;
+    }
+    return true;
+}
+
+unsigned PointsToRelation::hash() const {
+    // The order of the keys in the map depends on the history of insertions,
+    // so combine the hashes of the entries using addition.
+    size_t H = count;
+    for (auto &P : s) {
+        hash_code E = hash_value(P.first);
+        for (PointsToNode *Pointee : P.second)
+            E = hash_combine(E, Pointee->getId());
+        H += E;
+    }
+    return H;
+}
+
 void PointsToRelation::dump() const {
+    // Sort the pairs so that the output does not depend on the layout of the
+    // hash table.
+    SmallVector<std::pair<PointsToNode *, PointsToNode *>, 16> pairs(begin(), end());
+    std::sort(pairs.begin(), pairs.end(), PointsToPairLess());
+
     bool first = true;
-    for (auto P : s) {
+    for (auto P : pairs) {
         if (!first)
             errs() << ", ";
         first = false;
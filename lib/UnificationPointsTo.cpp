@@ -0,0 +1,304 @@
+#include <algorithm>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Operator.h"
+
+#include "UnificationPointsTo.h"
+
+unsigned UnificationPointsTo::createClass() {
+    unsigned C = classes.size();
+    classes.push_back({C, 1, NoClass, false, {}});
+    return C;
+}
+
+unsigned UnificationPointsTo::find(unsigned C) const {
+    while (classes[C].parent != C)
+        C = classes[C].parent;
+    return C;
+}
+
+// Merges the classes A and B, and then the classes that they point to.
+void UnificationPointsTo::join(unsigned A, unsigned B) {
+    SmallVector<std::pair<unsigned, unsigned>, 8> Pending(1, {A, B});
+    while (!Pending.empty()) {
+        auto P = Pending.pop_back_val();
+        unsigned X = find(P.first), Y = find(P.second);
+        if (X == Y)
+            continue;
+        if (classes[X].size < classes[Y].size)
+            std::swap(X, Y);
+        Class &Root = classes[X], &Other = classes[Y];
+        Other.parent = X;
+        Root.size += Other.size;
+        Root.unknown |= Other.unknown;
+        Root.functions.append(Other.functions.begin(), Other.functions.end());
+        Other.functions.clear();
+        if (Root.pointee == NoClass)
+            Root.pointee = Other.pointee;
+        else if (Other.pointee != NoClass)
+            Pending.push_back({Root.pointee, Other.pointee});
+    }
+}
+
+unsigned UnificationPointsTo::getPointee(unsigned C) {
+    C = find(C);
+    if (classes[C].pointee == NoClass) {
+        unsigned Pointee = createClass();
+        classes[C].pointee = Pointee;
+    }
+    return classes[C].pointee;
+}
+
+unsigned UnificationPointsTo::getClass(const Value *V) {
+    // Constants that aren't made from globals don't point to anything, so
+    // they don't need to share a class with the other places they are used.
+    const Constant *C = dyn_cast<Constant>(V);
+    if (C != nullptr && !isa<GlobalValue>(C) && !isa<ConstantExpr>(C) && !isa<ConstantArray>(C) && !isa<ConstantStruct>(C) && !isa<ConstantVector>(C))
+        return createClass();
+
+    auto Inserted = values.insert({V, 0});
+    if (!Inserted.second)
+        return Inserted.first->second;
+    unsigned Class = createClass();
+    Inserted.first->second = Class;
+
+    if (const Function *F = dyn_cast<Function>(V))
+        classes[Class].functions.push_back(F);
+    else if (const GEPOperator *GEP = dyn_cast<GEPOperator>(V)) {
+        if (isa<ConstantExpr>(GEP))
+            join(Class, getClass(GEP->getPointerOperand()));
+    }
+    else if (C != nullptr && !isa<GlobalValue>(C)) {
+        for (const Value *Op : C->operands())
+            join(Class, getClass(Op));
+    }
+    return find(Class);
+}
+
+unsigned UnificationPointsTo::getReturnClass(const Function *F) {
+    auto Inserted = returns.insert({F, 0});
+    if (Inserted.second) {
+        unsigned Class = createClass();
+        Inserted.first->second = Class;
+    }
+    return Inserted.first->second;
+}
+
+// Returns true if calls to the library function Name don't store any
+// pointers and don't return one that already exists. This isn't the list
+// that the main analysis uses (see isConstant), since that one includes
+// functions that do store pointers, such as strtol.
+static bool leavesPointersAlone(StringRef Name) {
+    return Name == "fprintf"
+        || Name == "fflush"
+        || Name == "fwrite"
+        || Name == "fputc"
+        || Name == "strcmp"
+        || Name == "strlen"
+        || Name == "printf"
+        || Name == "exit"
+        || Name == "putchar"
+        || Name == "sprintf"
+        || Name == "puts"
+        || Name == "strncmp"
+        || Name == "_IO_putc"
+        || Name == "fclose"
+        || Name == "malloc"
+        || Name == "calloc"
+        || Name == "free"
+        || Name == "floor"
+        || Name == "ceil";
+}
+
+// Returns true if Name stores a pointer into its first argument through its
+// second, as strtol does with the end of the number that it reads.
+static bool storesEndPointer(StringRef Name) {
+    return Name == "strtol"
+        || Name == "strtoul"
+        || Name == "strtoll"
+        || Name == "strtoull"
+        || Name == "strtod"
+        || Name == "strtof"
+        || Name == "strtold";
+}
+
+// Links the arguments and the return value of CI to those of F.
+void UnificationPointsTo::addCall(const CallInst *CI, const Function *F) {
+    if (F->isDeclaration()) {
+        StringRef Name = F->getName();
+        if (Name.startswith("llvm.memcpy") || Name.startswith("llvm.memmove"))
+            join(getPointee(getClass(CI->getArgOperand(0))), getPointee(getClass(CI->getArgOperand(1))));
+        else if (Name.startswith("llvm.va_start") || Name.startswith("llvm.va_copy"))
+            // The argument list is filled in with the variable arguments,
+            // which may be anything.
+            join(getPointee(getClass(CI->getArgOperand(0))), unknownClass);
+        else if (Name.startswith("llvm.")) {
+            // Some intrinsics return one of their arguments, or a pointer
+            // that isn't known to the module (such as the frame address).
+            if (CI->getType()->isPointerTy())
+                join(getClass(CI), unknownClass);
+        }
+        else if (storesEndPointer(Name) && F->arg_size() >= 2)
+            join(getPointee(getClass(CI->getArgOperand(1))), getClass(CI->getArgOperand(0)));
+        else if (!leavesPointersAlone(Name))
+            addUnknownCall(CI);
+        // The other declarations don't change what anything points to, and
+        // the values that they return are new.
+        return;
+    }
+
+    auto Formal = F->arg_begin(), FormalEnd = F->arg_end();
+    for (const Value *Actual : CI->arg_operands()) {
+        if (Formal == FormalEnd) {
+            // The variable arguments may be read in any way.
+            join(getClass(Actual), unknownClass);
+            continue;
+        }
+        join(getClass(Actual), getClass(&*Formal));
+        ++Formal;
+    }
+    join(getClass(CI), getReturnClass(F));
+}
+
+// Code outside the module may do anything with what the arguments point to,
+// and may return anything that it can reach.
+void UnificationPointsTo::addUnknownCall(const CallInst *CI) {
+    for (const Value *Actual : CI->arg_operands())
+        join(getClass(Actual), unknownClass);
+    join(getClass(CI), unknownClass);
+}
+
+void UnificationPointsTo::addInstruction(const Instruction *I, SmallVectorImpl<const CallInst *> &IndirectCalls) {
+    if (const LoadInst *LI = dyn_cast<LoadInst>(I))
+        join(getClass(LI), getPointee(getClass(LI->getPointerOperand())));
+    else if (const StoreInst *SI = dyn_cast<StoreInst>(I))
+        join(getPointee(getClass(SI->getPointerOperand())), getClass(SI->getValueOperand()));
+    else if (const AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I)) {
+        unsigned Pointee = getPointee(getClass(RMW->getPointerOperand()));
+        join(Pointee, getClass(RMW->getValOperand()));
+        join(getClass(RMW), Pointee);
+    }
+    else if (const AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(I)) {
+        unsigned Pointee = getPointee(getClass(CX->getPointerOperand()));
+        join(Pointee, getClass(CX->getNewValOperand()));
+        join(getClass(CX), Pointee);
+    }
+    else if (const CallInst *CI = dyn_cast<CallInst>(I)) {
+        if (const Function *F = CI->getCalledFunction())
+            addCall(CI, F);
+        else if (CI->isInlineAsm())
+            addUnknownCall(CI);
+        else
+            IndirectCalls.push_back(CI);
+    }
+    else if (const ReturnInst *RI = dyn_cast<ReturnInst>(I)) {
+        if (RI->getReturnValue() != nullptr)
+            join(getReturnClass(RI->getParent()->getParent()), getClass(RI->getReturnValue()));
+    }
+    else if (const GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(I))
+        join(getClass(GEP), getClass(GEP->getPointerOperand()));
+    else if (isa<VAArgInst>(I))
+        // The variable arguments may be anything (see addCall).
+        join(getClass(I), unknownClass);
+    else if (isa<InvokeInst>(I)) {
+        // Invokes aren't analysed, so assume the worst of them.
+        join(getClass(I), unknownClass);
+        for (const Value *Op : I->operands())
+            join(getClass(Op), unknownClass);
+    }
+    else if (!I->getType()->isVoidTy() && !isa<CmpInst>(I) && !isa<AllocaInst>(I)) {
+        // Casts, phis, selects, arithmetic and the instructions that take
+        // aggregates apart or put them together may pass on any of their
+        // operands.
+        for (const Value *Op : I->operands())
+            join(getClass(I), getClass(Op));
+    }
+}
+
+void UnificationPointsTo::compute(const Module &M) {
+    classes.clear();
+    values.clear();
+    returns.clear();
+    unknownClass = createClass();
+    classes[unknownClass].unknown = true;
+    classes[unknownClass].pointee = unknownClass;
+
+    for (const GlobalVariable &G : M.globals()) {
+        // Code outside the module can store anything in the globals that it
+        // can see, and in the ones that are defined outside the module. A
+        // global whose address escapes is merged into the unknown class
+        // itself, which points to itself, so its contents are unknown too.
+        if (!G.hasLocalLinkage() || !G.hasInitializer())
+            join(getPointee(getClass(&G)), unknownClass);
+        if (G.hasInitializer())
+            join(getPointee(getClass(&G)), getClass(G.getInitializer()));
+    }
+    for (const GlobalAlias &A : M.aliases())
+        join(getClass(&A), getClass(A.getAliasee()));
+
+    SmallVector<const CallInst *, 16> IndirectCalls;
+    for (const Function &F : M)
+        for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+            addInstruction(&*I, IndirectCalls);
+
+    // The targets of the indirect calls, and the functions that code outside
+    // the module may call, are only known once the classes of the pointers to
+    // them have stopped growing.
+    DenseSet<std::pair<const CallInst *, const Function *>> Linked;
+    DenseSet<const Value *> Escaped;
+    bool Changed = true;
+    while (Changed) {
+        Changed = false;
+        for (const CallInst *CI : IndirectCalls) {
+            unsigned Called = find(getClass(CI->getCalledValue()));
+            if (classes[Called].unknown) {
+                if (Escaped.insert(CI).second) {
+                    addUnknownCall(CI);
+                    Changed = true;
+                }
+                continue;
+            }
+            SmallVector<const Function *, 4> Targets(classes[Called].functions.begin(), classes[Called].functions.end());
+            for (const Function *F : Targets) {
+                if (Linked.insert({CI, F}).second) {
+                    addCall(CI, F);
+                    Changed = true;
+                }
+            }
+        }
+        for (const Function &F : M) {
+            if (F.isDeclaration() || Escaped.count(&F) != 0)
+                continue;
+            if (!F.hasLocalLinkage() || classes[find(getClass(&F))].unknown) {
+                Escaped.insert(&F);
+                for (const Argument &A : F.args())
+                    join(getClass(&A), unknownClass);
+                join(getReturnClass(&F), unknownClass);
+                Changed = true;
+            }
+        }
+    }
+}
+
+bool UnificationPointsTo::getCallees(const CallInst *CI, SmallVectorImpl<const Function *> &Callees) const {
+    auto Found = values.find(CI->getCalledValue());
+    if (Found == values.end())
+        return false;
+    // A pointer that can't point to any function (such as null) is left for
+    // the caller to treat as unresolved, as is one that code outside the
+    // module may have made.
+    const Class &Called = classes[find(Found->second)];
+    if (Called.unknown || Called.functions.empty())
+        return false;
+    Callees.append(Called.functions.begin(), Called.functions.end());
+    return true;
+}
+
+bool UnificationPointsTo::mayAlias(const Value *A, const Value *B) const {
+    auto FoundA = values.find(A), FoundB = values.find(B);
+    if (FoundA == values.end() || FoundB == values.end())
+        return true;
+    unsigned ClassA = find(FoundA->second), ClassB = find(FoundB->second);
+    return ClassA == ClassB || classes[ClassA].unknown || classes[ClassB].unknown;
+}
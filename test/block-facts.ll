@@ -0,0 +1,43 @@
+; Storing facts only at block boundaries and pointer-relevant instructions
+; doesn't change the facts at any instruction.
+; RUN: opt -load %lfcpa -test-pass -disable-output %s 2>&1 | grep -v -e "Worklist iterations" -e "Times ran" > %t.dense
+; RUN: opt -load %lfcpa -test-pass -lfcpa-block-facts -disable-output %s 2>&1 | grep -v -e "Worklist iterations" -e "Times ran" > %t.block
+; RUN: diff %t.dense %t.block
+
+@a = global i32 0
+@b = global i32 0
+
+define void @set(i32** %p, i32* %v) {
+  %n = add i32 1, 2
+  %m = mul i32 %n, %n
+  store i32* %v, i32** %p
+  %k = sub i32 %m, 1
+  ret void
+}
+
+define i32 @main(i32 %c) {
+entry:
+  %x = alloca i32*
+  %y = alloca i32*
+  store i32* @a, i32** %x
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %j, %loop ]
+  %j = add i32 %i, 1
+  %t = mul i32 %j, 3
+  call void @set(i32** %y, i32* @b)
+  %s = sub i32 %t, %c
+  %cmp = icmp slt i32 %s, 10
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %d = add i32 %c, 1
+  %px = load i32*, i32** %x
+  %e = mul i32 %d, 2
+  %py = load i32*, i32** %y
+  %vx = load i32, i32* %px
+  %vy = load i32, i32* %py
+  %r = add i32 %vx, %vy
+  ret i32 %r
+}
@@ -0,0 +1,30 @@
+; Once a budget stops the analysis, its facts aren't printed or used, and the
+; alias queries are answered by the unification pre-pass alone.
+; RUN: opt -load %lfcpa -test-pass -lfcpa-iteration-budget=1 -disable-output %s 2>&1 | FileCheck %s --check-prefix=FACTS
+; RUN: opt -load %lfcpa -lfcpa -lfcpa-iteration-budget=1 -aa-eval -print-all-alias-modref-info -disable-output %s 2>&1 | FileCheck %s --check-prefix=ALIAS
+
+; FACTS: Warning: the analysis went over its iteration budget
+; FACTS: The analysis is incomplete, so no facts are printed
+; FACTS-NOT: Function:
+; FACTS-NOT: Aout:
+
+; %v only points to %y here, but the pre-pass merges %x and %y because both
+; are stored in %s. %z is never stored anywhere, so it is kept apart.
+; ALIAS: Warning: the analysis went over its iteration budget
+; ALIAS-LABEL: Function: main
+; ALIAS-DAG: MayAlias: i32* %v, i32* %x
+; ALIAS-DAG: NoAlias: i32* %v, i32* %z
+; ALIAS-DAG: NoAlias: i32* %x, i32* %z
+define void @main() {
+  %x = alloca i32
+  %y = alloca i32
+  %z = alloca i32
+  %s = alloca i32*
+  store i32* %x, i32** %s
+  store i32* %y, i32** %s
+  %v = load i32*, i32** %s
+  store i32 0, i32* %v
+  store i32 1, i32* %x
+  store i32 2, i32* %z
+  ret void
+}
@@ -0,0 +1,48 @@
+; Truncating the call strings merges the contexts of each function, but none
+; of these functions is recursive, so the store four calls down is still a
+; strong update and main sees it, and no context is made cyclic.
+; RUN: opt -load %lfcpa -test-pass -lfcpa-k=1 -disable-output %s 2>&1 | FileCheck %s
+; RUN: opt -load %lfcpa -test-pass -lfcpa-k=2 -disable-output %s 2>&1 | FileCheck %s
+; RUN: opt -load %lfcpa -test-pass -lfcpa-k=1 -disable-output %s 2>&1 | FileCheck %s --check-prefix=ACYCLIC
+
+; ACYCLIC-NOT: ]*
+
+; CHECK-LABEL: Number of call strings for f4:
+; CHECK: Call string: ...,{{.*}}call void @f4(i32** %p)
+; CHECK-LABEL: Number of call strings for main: 1
+; CHECK: call void @f1(i32** %x)
+; CHECK-NEXT: Aout: {{.*}}alloca:x-->global:a
+; CHECK-NOT: alloca:x-->?
+; CHECK: %v = load i32*, i32** %x
+; CHECK-NEXT: Aout: {{.*}}v-->global:a
+; CHECK-NOT: v-->?
+
+@a = global i32 0
+
+define void @f4(i32** %p) {
+  store i32* @a, i32** %p
+  ret void
+}
+
+define void @f3(i32** %p) {
+  call void @f4(i32** %p)
+  ret void
+}
+
+define void @f2(i32** %p) {
+  call void @f3(i32** %p)
+  ret void
+}
+
+define void @f1(i32** %p) {
+  call void @f2(i32** %p)
+  ret void
+}
+
+define i32 @main() {
+  %x = alloca i32*
+  call void @f1(i32** %x)
+  %v = load i32*, i32** %x
+  %r = load i32, i32* %v
+  ret i32 %r
+}
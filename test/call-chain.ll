@@ -0,0 +1,56 @@
+; A store four calls down from main reaches main through every callee on the
+; chain, and each callee is analysed in the context of main's call.
+; RUN: opt -load %lfcpa -test-pass -disable-output %s 2>&1 | FileCheck %s
+
+@a = global i32 0
+
+; CHECK-LABEL: Number of call strings for f4: 5
+; CHECK: Call string: {{ *}}call void @f1(i32** %x), {{ *}}call void @f2(i32** %p), {{ *}}call void @f3(i32** %p), {{ *}}call void @f4(i32** %p)
+; CHECK-NEXT: :
+; CHECK-NEXT: Lin: {{.*}}p
+; CHECK-NEXT: store i32* @a, i32** %p
+; CHECK-NEXT: Aout: {{.*}}alloca:x-->global:a
+define void @f4(i32** %p) {
+  store i32* @a, i32** %p
+  ret void
+}
+
+; CHECK-LABEL: Number of call strings for f3: 4
+; CHECK: Call string: {{ *}}call void @f1(i32** %x), {{ *}}call void @f2(i32** %p), {{ *}}call void @f3(i32** %p)
+; CHECK-NEXT: :
+; CHECK-NEXT: Lin: {{.*}}p
+; CHECK-NEXT: call void @f4(i32** %p)
+; CHECK-NEXT: Aout: {{.*}}alloca:x-->global:a
+define void @f3(i32** %p) {
+  call void @f4(i32** %p)
+  ret void
+}
+
+; CHECK-LABEL: Number of call strings for f2: 3
+; CHECK: Call string: {{ *}}call void @f1(i32** %x), {{ *}}call void @f2(i32** %p)
+; CHECK-NEXT: :
+; CHECK-NEXT: Lin: {{.*}}p
+; CHECK-NEXT: call void @f3(i32** %p)
+; CHECK-NEXT: Aout: {{.*}}alloca:x-->global:a
+define void @f2(i32** %p) {
+  call void @f3(i32** %p)
+  ret void
+}
+
+define void @f1(i32** %p) {
+  call void @f2(i32** %p)
+  ret void
+}
+
+; CHECK-LABEL: Number of call strings for main: 1
+; CHECK: call void @f1(i32** %x)
+; CHECK-NEXT: Aout: {{.*}}alloca:x-->global:a
+; CHECK: %v = load i32*, i32** %x
+; CHECK-NEXT: Aout: {{.*}}v-->global:a
+define i32 @main() {
+  %x = alloca i32*
+  call void @f1(i32** %x)
+  %v = load i32*, i32** %x
+  %r = load i32, i32* %v
+  ret i32 %r
+}
@@ -0,0 +1,59 @@
+; The unification pre-pass must not separate pointers that code outside the
+; module may have made equal.
+; RUN: opt -load %lfcpa -lfcpa -lfcpa-unification -aa-eval -print-all-alias-modref-info -disable-output %s 2>&1 | FileCheck %s
+
+@p = external global i32*
+@q = external global i32*
+@g = internal global i32* null
+
+declare void @ext(i32**)
+declare i8* @llvm.ptr.annotation.p0i8(i8*, i8*, i8*, i32)
+declare i64 @strtol(i8*, i8**, i32)
+
+; Both globals can be set to the same pointer outside the module.
+; CHECK-LABEL: Function: externals
+; CHECK: MayAlias: i32* %x, i32* %y
+define void @externals() {
+  %x = load i32*, i32** @p
+  %y = load i32*, i32** @q
+  store i32 0, i32* %x
+  store i32 1, i32* %y
+  ret void
+}
+
+; @g's address is passed outside the module, so anything can be stored in it.
+; CHECK-LABEL: Function: escaped
+; CHECK-NOT: NoAlias: i32* %e, i32* %n
+define void @escaped() {
+  call void @ext(i32** @g)
+  %e = load i32*, i32** @g
+  %n = load i32*, i32** @p
+  store i32 0, i32* %e
+  store i32 1, i32* %n
+  ret void
+}
+
+; The annotation returns its argument.
+; CHECK-LABEL: Function: annotated
+; CHECK-NOT: NoAlias: i8* %an, i8* %m
+define void @annotated() {
+  %m = alloca i8
+  %an = call i8* @llvm.ptr.annotation.p0i8(i8* %m, i8* null, i8* null, i32 0)
+  store i8 0, i8* %an
+  store i8 1, i8* %m
+  ret void
+}
+
+; strtol stores a pointer into %buf in %end.
+; CHECK-LABEL: Function: parse
+; CHECK-NOT: NoAlias: i8* %e, i8* %s
+define i64 @parse() {
+  %buf = alloca [16 x i8]
+  %end = alloca i8*
+  %s = getelementptr inbounds [16 x i8], [16 x i8]* %buf, i64 0, i64 0
+  %n = call i64 @strtol(i8* %s, i8** %end, i32 10)
+  %e = load i8*, i8** %end
+  store i8 0, i8* %e
+  store i8 1, i8* %s
+  ret i64 %n
+}